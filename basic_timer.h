@@ -0,0 +1,317 @@
+#ifndef _BASIC_TIMER_HEADER_
+#define _BASIC_TIMER_HEADER_
+
+#include "timer.h"
+
+namespace gsf
+{
+	namespace utils
+	{
+		/**!
+			basic timer
+			Timer for a heap that only ever holds one kind of callback, e.g. every
+			connection timeout calling Session::onTimeout(id). the Callback is
+			stored by value in the event and called directly, so the call inlines:
+			no TimerCallback, no virtual handleTimeout, no shared_ptr.
+
+				struct SessionTimeout
+				{
+					Session *session;
+					uint64_t id;
+					void operator()() { session->onTimeout(id); }
+				};
+				BasicTimer<SessionTimeout> timeouts;
+				TimerID id = timeouts.add_timer(delay_milliseconds(30000), SessionTimeout{ session, 42 });
+
+			Callback must be default constructible and move assignable, a released
+			event's callback is reset to Callback(). delay_milliseconds and
+			delay_repeat are supported. one thread only, no inbox or shard
+			routing: its ids carry shard TIMER_SHARD_MAX and only mean something
+			to the BasicTimer that returned them.
+
+			the queue is a policy from timer_queue.h, GSF_TIMER_QUEUE (the same as
+			Timer's) unless given:
+
+				BasicTimer<SessionTimeout, radix_heap_queue> timeouts;
+		*/
+
+		template <typename Callback>
+		struct BasicTimerEvent
+		{
+			Callback callback_;
+			int64_t tp_;
+			int64_t period_;	//! 0 for one-shot timers
+			int32_t min_heap_idx;
+
+			BasicTimerEvent *list_prev;
+			BasicTimerEvent *list_next;
+			int32_t list_slot;
+
+			uint32_t pool_idx;
+			uint32_t generation;
+			uint32_t state_;	//! BASIC_TIMER_*
+		};
+
+		enum
+		{
+			BASIC_TIMER_QUEUED = 0,
+			BASIC_TIMER_FIRING = 1,		//! in its callback
+			BASIC_TIMER_CANCEL = 2,		//! periodic timer removed during its callback
+			BASIC_TIMER_MOVED = 3,		//! periodic timer rescheduled during its callback, tp_ is its next firing
+		};
+
+		template <typename Callback, template <typename> class Queue = GSF_TIMER_QUEUE>
+		class BasicTimer
+		{
+		public:
+			typedef BasicTimerEvent<Callback> Event;
+
+			BasicTimer();
+			~BasicTimer();
+
+			//! the id of the armed timer, 0 if the delay type isn't supported
+			template <typename T>
+			TimerID add_timer(T delay, Callback callback);
+
+			//! 0 succ, -1 if the id is stale. a periodic timer may stop itself from its callback
+			int rmv_timer(TimerID id);
+
+			//! as Timer::reschedule, a later deadline is sifted at once instead of deferred
+			template <typename T>
+			int reschedule(TimerID id, T delay);
+
+			void update();
+			void update(int64_t now);
+
+			//! as Timer::next_deadline / Timer::next_timeout
+			int64_t next_deadline();
+			int next_timeout();
+
+			template <typename Clock>
+			void use_clock();
+
+			int64_t now() const { return now_; }
+
+		private:
+			BasicTimer(const BasicTimer &);
+			BasicTimer & operator = (const BasicTimer &);
+
+			template <typename T>
+			static int64_t delay_offset(const T &) { return -1; }
+			static int64_t delay_offset(delay_milliseconds delay) { return delay.milliseconds(); }
+			static int64_t delay_offset(delay_repeat delay) { return delay.period() ? delay.first() : -1; }
+
+			template <typename T>
+			static int64_t delay_period(const T &) { return 0; }
+			static int64_t delay_period(delay_repeat delay) { return delay.period(); }
+
+			void push_event(Event *e);
+			void erase_event(Event *e);
+			void rearm_event(Event *e);
+			Event * pop_expired(int64_t now);
+			void release_event(Event *e);
+
+		private:
+			int64_t(*clock_)();
+			int64_t now_;
+
+			event_pool<Event> event_pool_;
+
+			Queue<Event> queue_;
+		};
+
+		template <typename Callback, template <typename> class Queue>
+		BasicTimer<Callback, Queue>::BasicTimer()
+			: clock_(&steady_clock_source::now)
+			, now_(steady_clock_source::now())
+		{
+			event_pool_ctor(&event_pool_);
+			queue_.rebase(now_);
+		}
+
+		template <typename Callback, template <typename> class Queue>
+		BasicTimer<Callback, Queue>::~BasicTimer()
+		{
+			event_pool_dtor(&event_pool_);
+		}
+
+		template <typename Callback, template <typename> class Queue>
+		template <typename Clock>
+		void BasicTimer<Callback, Queue>::use_clock()
+		{
+			clock_ = &Clock::now;
+			now_ = clock_();
+			queue_.rebase(now_);
+		}
+
+		template <typename Callback, template <typename> class Queue>
+		template <typename T>
+		TimerID BasicTimer<Callback, Queue>::add_timer(T delay, Callback callback)
+		{
+			int64_t _offset = delay_offset(delay);
+			if (_offset < 0){
+				return 0;
+			}
+
+			Event *_event = event_pool_alloc(&event_pool_);
+			Queue<Event>::elem_init(_event);
+			_event->callback_ = std::move(callback);
+			_event->tp_ = now_ + _offset;
+			_event->period_ = delay_period(delay);
+			_event->state_ = BASIC_TIMER_QUEUED;
+
+			push_event(_event);
+			return event_pool_id(_event, TIMER_SHARD_MAX);
+		}
+
+		template <typename Callback, template <typename> class Queue>
+		int BasicTimer<Callback, Queue>::rmv_timer(TimerID id)
+		{
+			Event *_event = timer_id_shard(id) == TIMER_SHARD_MAX ? event_pool_get(&event_pool_, id) : nullptr;
+			if (!_event){
+				return -1;
+			}
+
+			if (_event->state_ != BASIC_TIMER_QUEUED)
+			{
+				//! firing, a periodic timer is released by update() once its callback returns
+				if (_event->period_ && _event->state_ != BASIC_TIMER_CANCEL)
+				{
+					_event->state_ = BASIC_TIMER_CANCEL;
+					return 0;
+				}
+				return -1;
+			}
+
+			erase_event(_event);
+			release_event(_event);
+			return 0;
+		}
+
+		template <typename Callback, template <typename> class Queue>
+		template <typename T>
+		int BasicTimer<Callback, Queue>::reschedule(TimerID id, T delay)
+		{
+			int64_t _offset = delay_offset(delay);
+			Event *_event = _offset >= 0 && timer_id_shard(id) == TIMER_SHARD_MAX ? event_pool_get(&event_pool_, id) : nullptr;
+			if (!_event){
+				return -1;
+			}
+
+			if (_event->state_ == BASIC_TIMER_QUEUED)
+			{
+				_event->tp_ = now_ + _offset;
+				rearm_event(_event);
+				return 0;
+			}
+
+			//! periodic timer in its callback, update() rearms it at tp_ instead of a period later
+			if (_event->period_ && _event->state_ != BASIC_TIMER_CANCEL)
+			{
+				_event->tp_ = now_ + _offset;
+				_event->state_ = BASIC_TIMER_MOVED;
+				return 0;
+			}
+			return -1;
+		}
+
+		template <typename Callback, template <typename> class Queue>
+		void BasicTimer<Callback, Queue>::update()
+		{
+			update(clock_());
+		}
+
+		template <typename Callback, template <typename> class Queue>
+		void BasicTimer<Callback, Queue>::update(int64_t now)
+		{
+			now_ = now;
+
+			Event *_event = nullptr;
+			while ((_event = pop_expired(now_)) != nullptr)
+			{
+				_event->state_ = BASIC_TIMER_FIRING;
+				_event->callback_();
+
+				if (_event->period_ && _event->state_ != BASIC_TIMER_CANCEL)
+				{
+					//! missed periods are skipped, the phase is kept
+					if (_event->state_ == BASIC_TIMER_FIRING)
+					{
+						int64_t _tp = _event->tp_ + _event->period_;
+						if (_tp < now_){
+							_tp += (now_ - _tp + _event->period_ - 1) / _event->period_ * _event->period_;
+						}
+						_event->tp_ = _tp;
+					}
+					_event->state_ = BASIC_TIMER_QUEUED;
+					rearm_event(_event);
+					continue;
+				}
+
+				erase_event(_event);
+				release_event(_event);
+			}
+		}
+
+		template <typename Callback, template <typename> class Queue>
+		int64_t BasicTimer<Callback, Queue>::next_deadline()
+		{
+			return queue_.next_deadline();
+		}
+
+		template <typename Callback, template <typename> class Queue>
+		int BasicTimer<Callback, Queue>::next_timeout()
+		{
+			int64_t _deadline = next_deadline();
+			if (_deadline == INT64_MAX){
+				return -1;
+			}
+
+			int64_t _wait = _deadline + 1 - clock_();
+			if (_wait <= 0){
+				return 0;
+			}
+			return _wait > INT32_MAX ? INT32_MAX : static_cast<int>(_wait);
+		}
+
+		template <typename Callback, template <typename> class Queue>
+		void BasicTimer<Callback, Queue>::push_event(Event *e)
+		{
+			queue_.push(e);
+		}
+
+		template <typename Callback, template <typename> class Queue>
+		void BasicTimer<Callback, Queue>::erase_event(Event *e)
+		{
+			queue_.erase(e);
+		}
+
+		template <typename Callback, template <typename> class Queue>
+		void BasicTimer<Callback, Queue>::rearm_event(Event *e)
+		{
+			if (queue_.adjust(e)){
+				queue_.push(e);
+			}
+		}
+
+		template <typename Callback, template <typename> class Queue>
+		typename BasicTimer<Callback, Queue>::Event * BasicTimer<Callback, Queue>::pop_expired(int64_t now)
+		{
+			//! periodic events stay queued so they can be moved in place
+			Event *_event = queue_.top(now);
+			if (_event){
+				return _event->period_ ? _event : queue_.pop();
+			}
+			return nullptr;
+		}
+
+		template <typename Callback, template <typename> class Queue>
+		void BasicTimer<Callback, Queue>::release_event(Event *e)
+		{
+			e->callback_ = Callback();
+			event_pool_free(&event_pool_, e);
+		}
+	}
+}
+
+#endif
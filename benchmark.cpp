@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "timer.h"
+
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#if !defined(WIN32)
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#endif
+
+/**!
+	scheduler benchmark
+	g++ -O2 -std=c++11 benchmark.cpp -o benchmark [-DGSF_TIMER_USE_TIMING_WHEEL | -DGSF_TIMER_USE_DARY_HEAP | -DGSF_TIMER_USE_RADIX_HEAP] [-DGSF_TIMER_USE_NEAR_BUFFER]
+	./benchmark [max pending timers, default 1000000]
+
+	every case arms n timers, cancels part of them and then steps a synthetic
+	clock 1ms per update() until everything fired. each case runs in its own
+	process so peak rss belongs to that case alone.
+*/
+
+#if defined(__GLIBC__)
+//! count allocations by interposing the libc allocator
+static uint64_t alloc_count_ = 0;
+
+extern "C" void *__libc_malloc(size_t n);
+extern "C" void *__libc_calloc(size_t n, size_t s);
+extern "C" void *__libc_realloc(void *p, size_t n);
+
+extern "C" void *malloc(size_t n) { ++alloc_count_; return __libc_malloc(n); }
+extern "C" void *calloc(size_t n, size_t s) { ++alloc_count_; return __libc_calloc(n, s); }
+extern "C" void *realloc(void *p, size_t n) { ++alloc_count_; return __libc_realloc(p, n); }
+#define ALLOC_COUNT() alloc_count_
+#else
+#define ALLOC_COUNT() uint64_t(0)
+#endif
+
+enum Distribution
+{
+	dist_uniform,		//! 0 .. 60s
+	dist_same,			//! everything at 1s
+	dist_exponential,	//! mean 1s
+	dist_cancelled,		//! uniform, 90% cancelled before firing
+	dist_count,
+};
+
+static const char *dist_name_[dist_count] = { "uniform", "same", "exponential", "cancelled" };
+
+static const char * backend_name()
+{
+#if defined(GSF_TIMER_USE_TIMING_WHEEL)
+	return "timing_wheel";
+#elif defined(GSF_TIMER_USE_DARY_HEAP) && defined(GSF_TIMER_NEAR_BUFFER)
+	return "dary_heap+near_buffer";
+#elif defined(GSF_TIMER_USE_DARY_HEAP)
+	return "dary_heap";
+#elif defined(GSF_TIMER_USE_RADIX_HEAP) && defined(GSF_TIMER_NEAR_BUFFER)
+	return "radix_heap+near_buffer";
+#elif defined(GSF_TIMER_USE_RADIX_HEAP)
+	return "radix_heap";
+#elif defined(GSF_TIMER_NEAR_BUFFER)
+	return "min_heap+near_buffer";
+#else
+	return "min_heap";
+#endif
+}
+
+static double ns_per(std::chrono::steady_clock::duration d, uint64_t ops)
+{
+	return ops ? std::chrono::duration<double, std::nano>(d).count() / ops : 0.0;
+}
+
+static void run_case(Distribution dist, uint32_t n)
+{
+	using namespace gsf::utils;
+	typedef std::chrono::steady_clock clock;
+
+	std::mt19937_64 rng(n * 31 + dist);
+	std::exponential_distribution<double> expo(1.0 / 1000.0);
+
+	std::vector<uint32_t> delays(n);
+	for (uint32_t i = 0; i < n; ++i)
+	{
+		switch (dist)
+		{
+		case dist_same: delays[i] = 1000; break;
+		case dist_exponential: delays[i] = static_cast<uint32_t>(std::min(expo(rng), 600000.0)); break;
+		default: delays[i] = static_cast<uint32_t>(rng() % 60000); break;
+		}
+	}
+
+	std::vector<TimerID> ids(n);
+	std::vector<uint32_t> victims(n);
+	for (uint32_t i = 0; i < n; ++i)
+		victims[i] = i;
+	std::shuffle(victims.begin(), victims.end(), rng);
+	uint32_t cancels = dist == dist_cancelled ? n / 10 * 9 : n / 10;
+
+	Timer &timer = Timer::instance();
+	int64_t now = timer.now();
+	timer.update(now);
+
+	uint64_t fired = 0;
+	uint64_t allocs = ALLOC_COUNT();
+
+	auto t0 = clock::now();
+	for (uint32_t i = 0; i < n; ++i)
+	{
+		ids[i] = timer.add_timer(delay_milliseconds(delays[i]), [&fired]() { ++fired; });
+	}
+	auto t1 = clock::now();
+	for (uint32_t i = 0; i < cancels; ++i)
+	{
+		timer.rmv_timer(ids[victims[i]]);
+	}
+	auto t2 = clock::now();
+	uint64_t updates = 0;
+	uint32_t horizon = *std::max_element(delays.begin(), delays.end()) + 2;
+	for (uint32_t i = 0; i < horizon; ++i, ++updates)
+	{
+		timer.update(++now);
+	}
+	auto t3 = clock::now();
+
+	allocs = ALLOC_COUNT() - allocs;
+
+	long rss_kb = 0;
+#if !defined(WIN32)
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	rss_kb = ru.ru_maxrss;
+#endif
+
+	printf("%-12s %10u %10.1f %10.1f %12.1f %12.1f %10.4f %12ld\n"
+		, dist_name_[dist], n
+		, ns_per(t1 - t0, n), ns_per(t2 - t1, cancels)
+		, ns_per(t3 - t2, fired), ns_per(t3 - t2, updates)
+		, double(allocs) / (n + cancels), rss_kb);
+
+	if (fired != n - cancels)
+	{
+		printf("  fired %llu, expected %u\n", (unsigned long long)fired, n - cancels);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t max_n = argc > 1 ? static_cast<uint32_t>(atol(argv[1])) : 1000000;
+
+	printf("backend: %s\n", backend_name());
+	printf("%-12s %10s %10s %10s %12s %12s %10s %12s\n"
+		, "dist", "pending", "add ns", "rmv ns", "ns/fired", "ns/update", "allocs/op", "peak rss KB");
+
+	for (int dist = 0; dist < dist_count; ++dist)
+	{
+		for (uint32_t n = 1000; n <= max_n; n *= 10)
+		{
+			fflush(stdout);
+#if !defined(WIN32)
+			pid_t pid = fork();
+			if (pid == 0)
+			{
+				run_case(static_cast<Distribution>(dist), n);
+				fflush(stdout);
+				_exit(0);
+			}
+			int status = 0;
+			waitpid(pid, &status, 0);
+#else
+			run_case(static_cast<Distribution>(dist), n);
+#endif
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,208 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include "timer.h"
+
+#include <random>
+
+/**!
+	calendar check
+	g++ -O2 -std=c++11 calendar_check.cpp -o calendar_check
+	./calendar_check [samples per zone and expression, default 3, e.g. 60 for a thorough run]
+
+	compares calendar_next against a brute force walk over every utc minute
+	with localtime_r, in zones with and without daylight saving, around their
+	transitions and at random times. then checks parsing of malformed
+	expressions and how Timer arms calendar delays. posix only (TZ / tzset).
+	the exit code is the number of mismatches.
+*/
+
+using namespace gsf::utils;
+
+static int failed_ = 0;
+
+static bool match_tm(const calendar_schedule &s, const struct tm &tm)
+{
+	if (!(s.minutes >> tm.tm_min & 1) || !(s.hours >> tm.tm_hour & 1) || !(s.months >> (tm.tm_mon + 1) & 1)){
+		return false;
+	}
+
+	//! cron: with both day fields restricted either one matching is enough
+	bool _mday = (s.mdays >> tm.tm_mday & 1) != 0;
+	bool _wday = (s.wdays >> tm.tm_wday & 1) != 0;
+	if ((s.flags & (CALENDAR_MDAY_ANY | CALENDAR_WDAY_ANY)) == (CALENDAR_MDAY_ANY | CALENDAR_WDAY_ANY)){
+		return true;
+	}
+	if (s.flags & CALENDAR_MDAY_ANY){
+		return _wday;
+	}
+	if (s.flags & CALENDAR_WDAY_ANY){
+		return _mday;
+	}
+	return _mday || _wday;
+}
+
+static struct tm local_tm(int64_t sec)
+{
+	time_t _t = static_cast<time_t>(sec);
+	struct tm _tm;
+	localtime_r(&_t, &_tm);
+	return _tm;
+}
+
+/**!
+	first utc second (a whole minute) after from at which s fires, -1 if none
+	within limit seconds. a repeated local time only fires the first time, local
+	minutes skipped by a forward jump fire at the jump.
+*/
+static int64_t brute_next(const calendar_schedule &s, int64_t from, int64_t limit)
+{
+	for (int64_t t = (from / 60 + 1) * 60; t < from + limit; t += 60)
+	{
+		struct tm _tm = local_tm(t);
+		int64_t _offset = _tm.tm_gmtoff;
+		int64_t _prev = local_tm(t - 60).tm_gmtoff;
+
+		bool _repeated = false;
+		const int64_t _shifts[] = { 1800, 3600, 7200 };
+		for (int i = 0; i < 3; ++i)
+		{
+			struct tm _before = local_tm(t - _shifts[i]);
+			if (_before.tm_hour == _tm.tm_hour && _before.tm_min == _tm.tm_min && _before.tm_mday == _tm.tm_mday){
+				_repeated = true;
+			}
+		}
+		if (!_repeated && match_tm(s, _tm)){
+			return t;
+		}
+
+		if (_offset > _prev)
+		{
+			for (int64_t _local = (t - 60) + _prev + 60; _local < t + _offset; _local += 60)
+			{
+				time_t _l = static_cast<time_t>(_local);
+				struct tm _skipped;
+				gmtime_r(&_l, &_skipped);
+				if (match_tm(s, _skipped)){
+					return t;
+				}
+			}
+		}
+	}
+	return -1;
+}
+
+static void check_next(int samples)
+{
+	const char *_zones[] = { "UTC0", "America/New_York", "Europe/London", "Australia/Lord_Howe", "Asia/Shanghai", "Pacific/Chatham", "America/Santiago" };
+	const char *_exprs[] = { "* * * * *", "0 5 * * *", "30 2 * * *", "15 1 * * *", "*/7 * * * *", "0 0 29 2 *", "0 0 31 * *", "0 12 13 * fri",
+		"0 3 * * sun", "0 0 1 * *", "5-10/2 1,2,3 * jan-mar mon-wed", "@weekly", "0 9 1-7 * 1", "45 23 * * 7", "0 2 * 3,10,11 0" };
+	const int64_t _limit = 70 * 86400;
+
+	std::mt19937_64 _rng(7);
+	int _n = 0;
+	for (size_t z = 0; z < sizeof(_zones) / sizeof(_zones[0]); ++z)
+	{
+		setenv("TZ", _zones[z], 1);
+		tzset();
+		calendar_zone _zone;
+		calendar_zone_system(&_zone);
+
+		for (size_t e = 0; e < sizeof(_exprs) / sizeof(_exprs[0]); ++e)
+		{
+			calendar_schedule _s;
+			if (calendar_parse(&_s, _exprs[e]))
+			{
+				printf("parse failed '%s'\n", _exprs[e]);
+				++failed_;
+				continue;
+			}
+
+			for (int k = 0; k < samples; ++k, ++_n)
+			{
+				int64_t _from = time(0) - 300 * 86400 + static_cast<int64_t>(_rng() % (4 * 365 * 86400LL));
+				if (k % 3 == 0 && !_zone.transitions.empty())
+				{
+					const calendar_transition &_tr = _zone.transitions[_rng() % _zone.transitions.size()];
+					_from = _tr.utc / 1000 - 3 * 3600 + static_cast<int64_t>(_rng() % (6 * 3600));
+				}
+
+				int64_t _got = calendar_next(&_s, &_zone, _from * 1000 + static_cast<int64_t>(_rng() % 1000));
+				int64_t _want = brute_next(_s, _from, _limit);
+				if (_want < 0 ? (_got != INT64_MAX && _got < (_from + _limit) * 1000) : _got != _want * 1000)
+				{
+					printf("%s '%s' from %lld: got %lld want %lld\n", _zones[z], _exprs[e], (long long)_from, (long long)(_got == INT64_MAX ? -1 : _got / 1000), (long long)_want);
+					++failed_;
+				}
+			}
+		}
+	}
+	printf("calendar_next: %d samples\n", _n);
+
+	calendar_schedule _feb30;
+	calendar_parse(&_feb30, "0 0 30 2 *");
+	calendar_zone _fixed;
+	calendar_zone_fixed(&_fixed, 480);
+	if (calendar_next(&_feb30, &_fixed, 0) != INT64_MAX)
+	{
+		printf("feb 30 fires\n");
+		++failed_;
+	}
+}
+
+static void check_parse()
+{
+	const char *_bad[] = { "", "* * * *", "60 * * * *", "* 24 * * *", "* * 0 * *", "* * * 13 *", "* * * * 8", "a * * * *", "*/0 * * * *", "5-1 * * * *", "* * * * * *", "@foo" };
+	for (size_t i = 0; i < sizeof(_bad) / sizeof(_bad[0]); ++i)
+	{
+		calendar_schedule _s;
+		if (0 == calendar_parse(&_s, _bad[i]))
+		{
+			printf("accepted '%s'\n", _bad[i]);
+			++failed_;
+		}
+	}
+}
+
+static void check_timer()
+{
+	Timer _timer;
+	_timer.update(_timer.now());
+
+	//! a malformed expression is neither registered nor armed
+	uint32_t _registered = calendar_registry().n.load();
+	delay_calendar _bad("61 * * * *");
+	if (_bad.id() != 0 || calendar_registry().n.load() != _registered || _timer.add_timer(_bad, []() {}) != 0)
+	{
+		printf("malformed cron armed\n");
+		++failed_;
+	}
+
+	//! the schedule is registered once with the delay, equal ones share it
+	delay_day _day(6, 10);
+	if (!_day.id() || _day.id() != delay_day(6, 10).id() || _day.id() == delay_day(6, 11).id())
+	{
+		printf("delay_day ids\n");
+		++failed_;
+	}
+
+	TimerID _id = _timer.add_timer(_day, []() {});
+	if (!_id || _timer.next_deadline() - _timer.now() > 86400 * 1000 + 3600 * 1000 || _timer.rmv_timer(_id) != 0)
+	{
+		printf("delay_day not armed within a day\n");
+		++failed_;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int samples = argc > 1 ? atoi(argv[1]) : 3;
+
+	check_next(samples);
+	check_parse();
+	check_timer();
+
+	printf("%s\n", failed_ ? "FAILED" : "ok");
+	return failed_;
+}
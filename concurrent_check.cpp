@@ -0,0 +1,257 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "concurrent_timer.h"
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+/**!
+	concurrent timer check
+	g++ -O2 -std=c++11 -pthread concurrent_check.cpp -o concurrent_check [-fsanitize=thread]
+	./concurrent_check [timers, default 20000]
+
+	several threads call update() on one ConcurrentTimer on a synthetic clock.
+	first a frozen clock is stepped over many armed timers at once: a shard
+	must never run two callbacks side by side and must fire in deadline order,
+	and callbacks calling update() from several threads must not deadlock.
+	then timers are added and removed from other threads while the clock runs:
+	a one-shot timer fires exactly once unless rmv_timer returned 0, a removed
+	periodic timer stops. the exit code is the number of failed checks.
+*/
+
+using namespace gsf::utils;
+
+static std::atomic<int64_t> clock_now_(1000);
+
+struct check_clock
+{
+	static int64_t now() { return clock_now_.load(std::memory_order_relaxed); }
+};
+
+static const int UPDATE_THREADS = 4;
+static int failed_ = 0;
+
+//! every shard holds far more than a batch, each update() races for the same ones
+static void check_shard_order(int n)
+{
+	const unsigned _shards = 8;
+	ConcurrentTimer _timer(_shards);
+	_timer.use_clock<check_clock>();
+	int64_t _now = check_clock::now();
+
+	std::vector<TimerID> _ids(n);
+	std::vector<std::atomic<int> > _running(_shards);
+	std::vector<int64_t> _last(_shards, INT64_MIN);
+	std::atomic<int> _overlaps(0), _inversions(0), _fired(0);
+
+	std::mt19937 _rng(1);
+	for (int i = 0; i < n; ++i)
+	{
+		int64_t _tp = _now + _rng() % 1000;
+		_ids[i] = _timer.add_timer(delay_milliseconds(_tp - _now), [&, i, _tp]() {
+			uint32_t _shard = timer_id_shard(_ids[i]);
+			if (_running[_shard].fetch_add(1, std::memory_order_acq_rel)){
+				_overlaps.fetch_add(1, std::memory_order_relaxed);
+			}
+			if (_tp < _last[_shard]){
+				_inversions.fetch_add(1, std::memory_order_relaxed);
+			}
+			_last[_shard] = _tp;
+			std::this_thread::yield();
+			_running[_shard].fetch_sub(1, std::memory_order_acq_rel);
+			_fired.fetch_add(1, std::memory_order_relaxed);
+		});
+	}
+
+	clock_now_.store(_now + 2000);
+	std::vector<std::thread> _threads;
+	for (int k = 0; k < UPDATE_THREADS; ++k)
+	{
+		_threads.emplace_back([&]() {
+			while (_fired.load(std::memory_order_relaxed) < n){
+				_timer.update();
+			}
+		});
+	}
+	for (size_t k = 0; k < _threads.size(); ++k){
+		_threads[k].join();
+	}
+
+	if (_overlaps.load() || _inversions.load())
+	{
+		printf("shard order: %d callbacks overlapped, %d fired before an earlier deadline\n", _overlaps.load(), _inversions.load());
+		++failed_;
+	}
+}
+
+//! every callback calls update(), the threads' batches must not wait on each other
+static void check_nested_update(int n)
+{
+	ConcurrentTimer _timer(2);
+	_timer.use_clock<check_clock>();
+	int64_t _now = check_clock::now();
+
+	std::atomic<int> _fired(0);
+	for (int i = 0; i < n; ++i)
+	{
+		_timer.add_timer(delay_milliseconds(i % 10), [&]() {
+			std::this_thread::yield();
+			_timer.update();
+			_fired.fetch_add(1, std::memory_order_relaxed);
+		});
+	}
+
+	clock_now_.store(_now + 100);
+	std::vector<std::thread> _threads;
+	for (int k = 0; k < 2; ++k)
+	{
+		_threads.emplace_back([&]() {
+			while (_fired.load(std::memory_order_relaxed) < n){
+				_timer.update();
+			}
+		});
+	}
+
+	//! a deadlocked thread can't be joined, give up on the whole run
+	for (int ms = 0; _fired.load() < n; ++ms)
+	{
+		if (ms == 10000)
+		{
+			printf("nested update: %d of %d fired, update() threads deadlocked\n", _fired.load(), n);
+			fflush(stdout);
+			_Exit(failed_ + 1);
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	for (size_t k = 0; k < _threads.size(); ++k){
+		_threads[k].join();
+	}
+}
+
+//! removal races the update() threads, a periodic timer's callback may be in flight when it is removed
+static void check_rmv_race(int n)
+{
+	ConcurrentTimer _timer(8);
+	_timer.use_clock<check_clock>();
+
+	std::vector<std::atomic<int> > _fired(n), _removed(n), _fired_after(n);
+	std::vector<std::atomic<TimerID> > _ids(n);
+	std::atomic<int> _armed(0), _self_rmv(0);
+	std::atomic<bool> _stop(false);
+
+	std::vector<std::thread> _threads;
+	for (int k = 0; k < UPDATE_THREADS; ++k)
+	{
+		_threads.emplace_back([&]() {
+			while (!_stop.load()){
+				_timer.update();
+				std::this_thread::yield();
+			}
+		});
+	}
+	std::thread _ticker([&]() {
+		while (!_stop.load()){
+			clock_now_.fetch_add(1);
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+		}
+	});
+
+	std::thread _adder([&]() {
+		std::mt19937 _rng(1);
+		for (int i = 0; i < n; ++i)
+		{
+			uint32_t _delay = _rng() % 50;
+			if (i % 10 == 0)
+			{
+				_ids[i] = _timer.add_timer(delay_repeat(1 + _rng() % 5, _delay), [&, i]() {
+					if (_removed[i].load()){
+						_fired_after[i].fetch_add(1);
+					}
+					_fired[i].fetch_add(1);
+				});
+			}
+			else
+			{
+				_ids[i] = _timer.add_timer(delay_milliseconds(_delay), [&, i]() {
+					_fired[i].fetch_add(1);
+					//! a one-shot timer that is firing can't be removed
+					if (i % 7 == 0 && _timer.rmv_timer(_ids[i]) != -1){
+						_self_rmv.fetch_add(1);
+					}
+				});
+			}
+			_armed.store(i + 1, std::memory_order_release);
+		}
+	});
+
+	std::thread _remover([&]() {
+		std::mt19937 _rng(2);
+		for (int i = 0; i < n; std::this_thread::yield())
+		{
+			for (int _armed_n = _armed.load(std::memory_order_acquire); i < _armed_n; ++i)
+			{
+				if (i % 10 == 0 || _rng() % 2)
+				{
+					std::this_thread::yield();
+					if (0 == _timer.rmv_timer(_ids[i])){
+						_removed[i].store(1);
+					}
+				}
+			}
+		}
+	});
+
+	_adder.join();
+	_remover.join();
+
+	//! whatever is left is due within 50ms of the synthetic clock
+	int64_t _until = check_clock::now() + 100;
+	while (check_clock::now() < _until){
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	_stop = true;
+	for (size_t k = 0; k < _threads.size(); ++k){
+		_threads[k].join();
+	}
+	_ticker.join();
+	_timer.update(check_clock::now() + 100);
+
+	int _bad = 0;
+	for (int i = 0; i < n; ++i)
+	{
+		int _f = _fired[i].load(), _r = _removed[i].load();
+		if (i % 10 == 0)
+		{
+			//! at most one callback per update() thread was already claimed when it was removed
+			if (!_r || _fired_after[i].load() > UPDATE_THREADS)
+			{
+				if (_bad++ < 5) printf("periodic %d removed %d fired %d after removal\n", i, _r, _fired_after[i].load());
+			}
+			continue;
+		}
+		if (_r ? _f != 0 : _f != 1)
+		{
+			if (_bad++ < 5) printf("one-shot %d removed %d fired %d\n", i, _r, _f);
+		}
+	}
+
+	if (_bad || _self_rmv.load() || _timer.next_deadline() != INT64_MAX)
+	{
+		printf("rmv race: %d timers wrong, %d one-shots removed themselves, next deadline %lld\n", _bad, _self_rmv.load(), (long long)_timer.next_deadline());
+		++failed_;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int n = argc > 1 ? atoi(argv[1]) : 20000;
+
+	check_shard_order(n / 5);
+	check_nested_update(n / 50);
+	check_rmv_race(n);
+
+	printf("%s\n", failed_ ? "FAILED" : "ok");
+	return failed_;
+}
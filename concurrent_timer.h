@@ -0,0 +1,450 @@
+#ifndef _CONCURRENT_TIMER_HEADER_
+#define _CONCURRENT_TIMER_HEADER_
+
+#include "timer.h"
+
+#include <mutex>
+#include <condition_variable>
+
+namespace gsf
+{
+	namespace utils
+	{
+		/**!
+			concurrent timer
+			Timer whose update() may run on several threads at once, e.g. a few
+			dedicated timer threads sharing the expiry work. the pending timers are
+			spread round robin over shards, each a GSF_TIMER_QUEUE behind its own
+			mutex. update() starts at a different shard on every call, skips shards
+			another update() is draining and only comes back to wait for them once
+			the rest are done, so consumers rarely meet on a lock. order is relaxed:
+			a shard has one batch of claimed timers in flight at a time and fires
+			them in deadline order, different shards run side by side.
+
+				ConcurrentTimer timer;
+				for (int i = 0; i < 4; ++i)
+					threads.emplace_back([&]() { for (;;) { timer.update(); sleep(1ms); } });
+				TimerID id = timer.add_timer(delay_milliseconds(500), []() { ... });
+				timer.rmv_timer(id);
+
+			every call may come from any thread. an expired timer is claimed by
+			exactly one update() with a CAS on its sync word, rmv_timer tries the
+			same CAS, so exactly one of them wins: rmv_timer returns 0 and the
+			callback never starts, or -1 and it runs (a periodic timer can still be
+			stopped while firing, it is not re-armed). callbacks run without any
+			lock held and may call back into the timer. an update() from a callback
+			never waits for a shard, busy ones are left to the update() draining them.
+
+			events live in one event_pool per shard. a slot is never handed back to
+			the allocator while the timer lives, so rmv_timer can read the sync word
+			of a slot resolved from a stale id without a lock; the generation in it
+			turns away ids whose slot was released or reused. the slot itself is only
+			released under the shard lock, by whoever holds the event last.
+			delay_milliseconds and delay_repeat are supported. the timer must outlive
+			every call into it.
+		*/
+
+		struct ConcurrentTimerEvent
+		{
+			TimerCallback timer_callback_;
+			int64_t tp_;
+			int64_t period_;	//! 0 for one-shot timers
+			int32_t min_heap_idx;
+
+			ConcurrentTimerEvent *list_prev;
+			ConcurrentTimerEvent *list_next;
+			int32_t list_slot;
+
+			uint32_t pool_idx;
+			uint32_t generation;
+
+			//! generation << 32 | CONCURRENT_TIMER_*
+			std::atomic<uint64_t> sync;
+		};
+
+		enum
+		{
+			CONCURRENT_TIMER_ARMED = 1,		//! queued, may fire
+			CONCURRENT_TIMER_FIRING = 2,	//! claimed by an update(), its callback is running
+			CONCURRENT_TIMER_CANCEL = 4,	//! removed, the slot goes once the event leaves the queue
+			CONCURRENT_TIMER_REPEAT = 8,	//! periodic, can still be removed while firing
+		};
+
+		//! events claimed per lock hold
+		static const unsigned CONCURRENT_TIMER_BATCH = 64;
+
+		class ConcurrentTimer
+		{
+		public:
+			//! shards are capped at TIMER_SHARD_MAX, they are stamped into the TimerIDs
+			explicit ConcurrentTimer(unsigned shards = std::thread::hardware_concurrency() * 2);
+			~ConcurrentTimer();
+
+			//! the id of the armed timer, 0 if the delay type isn't supported or timer_callback is empty
+			template <typename T>
+			TimerID add_timer(T delay, TimerCallback timer_callback);
+
+			//! 0 if the timer won't fire (again), -1 if the id is stale or it is already firing
+			int rmv_timer(TimerID id);
+
+			//! fire everything due before now, together with any other thread calling update()
+			void update();
+			void update(int64_t now);
+
+			//! as Timer::next_deadline / Timer::next_timeout, a removed timer may still count
+			int64_t next_deadline();
+			int next_timeout();
+
+			//! call before arming timers, while no other thread uses the timer
+			template <typename Clock>
+			void use_clock();
+
+			int64_t now() const { return clock_(); }
+
+		private:
+			ConcurrentTimer(const ConcurrentTimer &);
+			ConcurrentTimer & operator = (const ConcurrentTimer &);
+
+			typedef ConcurrentTimerEvent Event;
+
+			struct shard
+			{
+				std::mutex lock;
+				GSF_TIMER_QUEUE<Event> queue;
+				event_pool<Event> pool;
+				std::atomic<int64_t> top;	//! earliest queued deadline, read without the lock
+				uint32_t index;
+
+				//! an update() is running a claimed batch. guarded by lock
+				bool draining;
+				std::condition_variable drained;
+			};
+
+			template <typename T>
+			static int64_t delay_offset(const T &) { return -1; }
+			static int64_t delay_offset(delay_milliseconds delay) { return delay.milliseconds(); }
+			static int64_t delay_offset(delay_repeat delay) { return delay.period() ? delay.first() : -1; }
+
+			template <typename T>
+			static int64_t delay_period(const T &) { return 0; }
+			static int64_t delay_period(delay_repeat delay) { return delay.period(); }
+
+			//! false if wait is false and another thread holds the shard
+			bool drain(shard &s, int64_t now, bool wait);
+			void finish_event(shard &s, Event *e, int64_t now);
+			void release_event(shard &s, Event *e);
+			static void publish_top(shard &s);
+
+			//! batches the calling thread is running callbacks of, on any ConcurrentTimer
+			static unsigned & batch_depth();
+
+		private:
+			int64_t(*clock_)();
+
+			std::vector<std::unique_ptr<shard>> shards_;
+			std::atomic<uint32_t> next_add_;
+			std::atomic<uint32_t> next_update_;
+		};
+
+		ConcurrentTimer::ConcurrentTimer(unsigned shards)
+			: clock_(&steady_clock_source::now)
+			, next_add_(0)
+			, next_update_(0)
+		{
+			if (shards == 0){
+				shards = 1;
+			}
+			if (shards > TIMER_SHARD_MAX){
+				shards = TIMER_SHARD_MAX;
+			}
+
+			for (unsigned i = 0; i < shards; ++i)
+			{
+				shards_.emplace_back(new shard());
+				shard &_s = *shards_.back();
+				event_pool_ctor(&_s.pool);
+				_s.queue.rebase(clock_());
+				_s.top.store(INT64_MAX, std::memory_order_relaxed);
+				_s.index = i;
+				_s.draining = false;
+			}
+		}
+
+		ConcurrentTimer::~ConcurrentTimer()
+		{
+			for (size_t i = 0; i < shards_.size(); ++i)
+			{
+				event_pool_dtor(&shards_[i]->pool);
+			}
+		}
+
+		template <typename Clock>
+		void ConcurrentTimer::use_clock()
+		{
+			clock_ = &Clock::now;
+			for (size_t i = 0; i < shards_.size(); ++i)
+			{
+				shards_[i]->queue.rebase(clock_());
+			}
+		}
+
+		template <typename T>
+		TimerID ConcurrentTimer::add_timer(T delay, TimerCallback timer_callback)
+		{
+			int64_t _offset = delay_offset(delay);
+			if (_offset < 0 || !timer_callback){
+				return 0;
+			}
+			int64_t _period = delay_period(delay);
+			int64_t _tp = clock_() + _offset;
+
+			shard &_s = *shards_[next_add_.fetch_add(1, std::memory_order_relaxed) % shards_.size()];
+			std::lock_guard<std::mutex> _guard(_s.lock);
+
+			Event *_event = event_pool_alloc(&_s.pool);
+			GSF_TIMER_QUEUE<Event>::elem_init(_event);
+			_event->timer_callback_ = std::move(timer_callback);
+			_event->tp_ = _tp;
+			_event->period_ = _period;
+			_event->sync.store((uint64_t(_event->generation) << 32) | CONCURRENT_TIMER_ARMED | (_period ? CONCURRENT_TIMER_REPEAT : 0), std::memory_order_release);
+
+			if (_s.queue.push(_event))
+			{
+				release_event(_s, _event);
+				return 0;
+			}
+			publish_top(_s);
+			return event_pool_id(_event, _s.index);
+		}
+
+		int ConcurrentTimer::rmv_timer(TimerID id)
+		{
+			uint32_t _shard = timer_id_shard(id);
+			if (_shard >= shards_.size()){
+				return -1;
+			}
+			shard &_s = *shards_[_shard];
+
+			Event *_event = event_pool_slot(&_s.pool, timer_id_index(id));
+			if (!_event){
+				return -1;
+			}
+
+			uint64_t _generation = uint64_t(timer_id_generation(id)) << 32;
+			uint64_t _sync = _event->sync.load(std::memory_order_acquire);
+			for (;;)
+			{
+				if ((_sync & ~uint64_t(0xffffffff)) != _generation || (_sync & CONCURRENT_TIMER_CANCEL)){
+					return -1;
+				}
+
+				if (_sync & CONCURRENT_TIMER_ARMED)
+				{
+					if (_event->sync.compare_exchange_weak(_sync, (_sync & ~uint64_t(CONCURRENT_TIMER_ARMED)) | CONCURRENT_TIMER_CANCEL, std::memory_order_acq_rel, std::memory_order_acquire)){
+						break;
+					}
+					continue;
+				}
+
+				//! firing, a periodic timer is released by its update() once the callback returns
+				if ((_sync & CONCURRENT_TIMER_FIRING) && (_sync & CONCURRENT_TIMER_REPEAT))
+				{
+					if (_event->sync.compare_exchange_weak(_sync, _sync | CONCURRENT_TIMER_CANCEL, std::memory_order_acq_rel, std::memory_order_acquire)){
+						return 0;
+					}
+					continue;
+				}
+				return -1;
+			}
+
+			//! won against update(), take it out unless an update() popped it (and released it) first
+			std::lock_guard<std::mutex> _guard(_s.lock);
+			if ((_event->sync.load(std::memory_order_relaxed) & ~uint64_t(0xffffffff)) == _generation && 0 == _s.queue.erase(_event))
+			{
+				release_event(_s, _event);
+				publish_top(_s);
+			}
+			return 0;
+		}
+
+		void ConcurrentTimer::update()
+		{
+			update(clock_());
+		}
+
+		void ConcurrentTimer::update(int64_t now)
+		{
+			size_t _n = shards_.size();
+			size_t _start = next_update_.fetch_add(1, std::memory_order_relaxed) % _n;
+
+			bool _busy = false;
+			for (size_t i = 0; i < _n; ++i)
+			{
+				if (!drain(*shards_[(_start + i) % _n], now, false)){
+					_busy = true;
+				}
+			}
+
+			//! whatever the other consumers left behind. a callback doesn't wait: the
+			//! update() it runs in may be just what another thread's callback waits for
+			if (_busy && 0 == batch_depth())
+			{
+				for (size_t i = 0; i < _n; ++i)
+				{
+					drain(*shards_[(_start + i) % _n], now, true);
+				}
+			}
+		}
+
+		bool ConcurrentTimer::drain(shard &s, int64_t now, bool wait)
+		{
+			Event *_batch[CONCURRENT_TIMER_BATCH];
+			for (;;)
+			{
+				if (s.top.load(std::memory_order_relaxed) >= now){
+					return true;
+				}
+
+				std::unique_lock<std::mutex> _guard(s.lock, std::defer_lock);
+				if (wait){
+					_guard.lock();
+				}
+				else if (!_guard.try_lock()){
+					return false;
+				}
+
+				//! the next batch may only be claimed once the one in flight is finished
+				if (s.draining)
+				{
+					if (!wait){
+						return false;
+					}
+					s.drained.wait(_guard, [&s]() { return !s.draining; });
+				}
+
+				unsigned _claimed = 0;
+				bool _more = false;
+				Event *_event = nullptr;
+				while ((_event = s.queue.top(now)) != nullptr)
+				{
+					if (_claimed == CONCURRENT_TIMER_BATCH)
+					{
+						_more = true;
+						break;
+					}
+					s.queue.pop();
+
+					uint64_t _sync = _event->sync.load(std::memory_order_acquire);
+					if ((_sync & CONCURRENT_TIMER_ARMED) && _event->sync.compare_exchange_strong(_sync, (_sync & ~uint64_t(CONCURRENT_TIMER_ARMED)) | CONCURRENT_TIMER_FIRING, std::memory_order_acq_rel, std::memory_order_acquire))
+					{
+						_batch[_claimed++] = _event;
+						continue;
+					}
+
+					//! removed, the rmv_timer that won leaves the slot to whoever holds the lock
+					release_event(s, _event);
+				}
+				publish_top(s);
+				if (_claimed){
+					s.draining = true;
+				}
+				_guard.unlock();
+
+				++batch_depth();
+				for (unsigned i = 0; i < _claimed; ++i)
+				{
+					_batch[i]->timer_callback_();
+				}
+				--batch_depth();
+
+				if (_claimed)
+				{
+					_guard.lock();
+					for (unsigned i = 0; i < _claimed; ++i)
+					{
+						finish_event(s, _batch[i], now);
+					}
+					publish_top(s);
+					s.draining = false;
+					_guard.unlock();
+					s.drained.notify_all();
+				}
+
+				if (!_more){
+					return true;
+				}
+			}
+		}
+
+		void ConcurrentTimer::finish_event(shard &s, Event *e, int64_t now)
+		{
+			uint64_t _sync = e->sync.load(std::memory_order_acquire);
+			if (e->period_ && !(_sync & CONCURRENT_TIMER_CANCEL))
+			{
+				//! missed periods are skipped, the phase is kept
+				int64_t _tp = e->tp_ + e->period_;
+				if (_tp < now){
+					_tp += (now - _tp + e->period_ - 1) / e->period_ * e->period_;
+				}
+				e->tp_ = _tp;
+
+				//! fails only if rmv_timer set CANCEL meanwhile
+				if (e->sync.compare_exchange_strong(_sync, (_sync & ~uint64_t(CONCURRENT_TIMER_FIRING)) | CONCURRENT_TIMER_ARMED, std::memory_order_acq_rel, std::memory_order_acquire))
+				{
+					if (0 == s.queue.push(e)){
+						return;
+					}
+
+					//! out of memory, the timer stops like a removed one
+					e->sync.store((_sync & ~uint64_t(CONCURRENT_TIMER_FIRING)) | CONCURRENT_TIMER_CANCEL, std::memory_order_release);
+				}
+			}
+			release_event(s, e);
+		}
+
+		void ConcurrentTimer::release_event(shard &s, Event *e)
+		{
+			e->timer_callback_.reset();
+			event_pool_free(&s.pool, e);
+			e->sync.store(uint64_t(e->generation) << 32, std::memory_order_release);
+		}
+
+		void ConcurrentTimer::publish_top(shard &s)
+		{
+			s.top.store(s.queue.next_deadline(), std::memory_order_relaxed);
+		}
+
+		unsigned & ConcurrentTimer::batch_depth()
+		{
+			static thread_local unsigned _depth = 0;
+			return _depth;
+		}
+
+		int64_t ConcurrentTimer::next_deadline()
+		{
+			int64_t _deadline = INT64_MAX;
+			for (size_t i = 0; i < shards_.size(); ++i)
+			{
+				int64_t _top = shards_[i]->top.load(std::memory_order_relaxed);
+				_deadline = _top < _deadline ? _top : _deadline;
+			}
+			return _deadline;
+		}
+
+		int ConcurrentTimer::next_timeout()
+		{
+			int64_t _deadline = next_deadline();
+			if (_deadline == INT64_MAX){
+				return -1;
+			}
+
+			int64_t _wait = _deadline + 1 - clock_();
+			if (_wait <= 0){
+				return 0;
+			}
+			return _wait > INT32_MAX ? INT32_MAX : static_cast<int>(_wait);
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,338 @@
+#ifndef _DARY_HEAP_HEADER_
+#define _DARY_HEAP_HEADER_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace gsf
+{
+	namespace utils
+	{
+		/**!
+			d-ary heap
+			drop-in for min_heap with the deadline cached next to the element pointer.
+			entries are 16 bytes and the array is offset so that every group of four
+			siblings shares one 64 byte cache line, so sifting compares keys without
+			dereferencing the elements (only the moved element's min_heap_idx is written).
+		*/
+
+		enum
+		{
+			DARY_HEAP_ARITY = 4,
+			DARY_HEAP_LINE = 64,
+		};
+
+		template <typename T>
+		struct dary_heap_entry
+		{
+			int64_t key;
+			T* e;
+		};
+
+		template <typename T>
+		struct dary_heap
+		{
+			dary_heap_entry<T>* p;	//! p[1] is cache line aligned
+			void* mem;
+			unsigned n, a;
+		};
+
+		template <typename T>
+		static inline void	     dary_heap_ctor(dary_heap<T>* s);
+
+		template <typename T>
+		static inline void	     dary_heap_dtor(dary_heap<T>* s);
+
+		template <typename T>
+		static inline void	     dary_heap_elem_init(T* e);
+
+		template <typename T>
+		static inline int64_t	 dary_heap_elem_key(const T* e);
+
+		template <typename T>
+		static inline int	     dary_heap_empty(dary_heap<T>* s);
+
+		template <typename T>
+		static inline unsigned	 dary_heap_size(dary_heap<T>* s);
+
+		template <typename T>
+		static inline T*		 dary_heap_top(dary_heap<T>* s);
+
+		template <typename T>
+		static inline int	     dary_heap_reserve(dary_heap<T>* s, unsigned n);
+
+		template <typename T>
+		static inline int	     dary_heap_push(dary_heap<T>* s, T* e);
+
+		template <typename T>
+		static inline T*		 dary_heap_pop(dary_heap<T>* s);
+
+		template <typename T>
+		static inline int	     dary_heap_erase(dary_heap<T>* s, T* e);
+
+		template <typename T>
+		static inline int	     dary_heap_adjust(dary_heap<T>* s, T* e);
+
+		template <typename T>
+		static inline void	     dary_heap_append(dary_heap<T>* s, T* e);
+
+		template <typename T>
+		static inline void	     dary_heap_heapify(dary_heap<T>* s, unsigned from);
+
+		template <typename T, typename F>
+		static inline unsigned	 dary_heap_sweep(dary_heap<T>* s, F fn);
+
+		template <typename T, typename F>
+		static inline unsigned	 dary_heap_count_below(dary_heap<T>* s, int64_t key, F fn);
+
+		template <typename T, typename F>
+		static inline unsigned	 dary_heap_count_below_(dary_heap<T>* s, unsigned index, int64_t key, F& fn);
+
+		template <typename T>
+		static inline void	     dary_heap_build_(dary_heap<T>* s, unsigned index, unsigned parents);
+
+		template <typename T>
+		static inline void	     dary_heap_shift_up_(dary_heap<T>* s, unsigned hole_index, dary_heap_entry<T> x);
+
+		template <typename T>
+		static inline void	     dary_heap_shift_down_(dary_heap<T>* s, unsigned hole_index, dary_heap_entry<T> x);
+
+		template <typename T>
+		int64_t dary_heap_elem_key(const T* e)
+		{
+			return e->tp_;
+		}
+
+		template <typename T>
+		void dary_heap_ctor(dary_heap<T>* s) { s->p = 0; s->mem = 0; s->n = 0; s->a = 0; }
+
+		template <typename T>
+		void dary_heap_dtor(dary_heap<T>* s) { if (s->mem) free(s->mem); }
+
+		template <typename T>
+		void dary_heap_elem_init(T* e) { e->min_heap_idx = -1; }
+
+		template <typename T>
+		int dary_heap_empty(dary_heap<T>* s) { return 0u == s->n; }
+
+		template <typename T>
+		unsigned dary_heap_size(dary_heap<T>* s) { return s->n; }
+
+		template <typename T>
+		T* dary_heap_top(dary_heap<T>* s) { return s->n ? s->p[0].e : 0; }
+
+		template <typename T>
+		int dary_heap_push(dary_heap<T>* s, T* e)
+		{
+			if (dary_heap_reserve(s, s->n + 1))
+				return -1;
+			dary_heap_entry<T> x = { dary_heap_elem_key(e), e };
+			dary_heap_shift_up_(s, s->n++, x);
+			return 0;
+		}
+
+		template <typename T>
+		T* dary_heap_pop(dary_heap<T>* s)
+		{
+			if (s->n)
+			{
+				T* e = s->p[0].e;
+				if (--s->n)
+					dary_heap_shift_down_(s, 0u, s->p[s->n]);
+				e->min_heap_idx = -1;
+				return e;
+			}
+			return 0;
+		}
+
+		template <typename T>
+		int dary_heap_erase(dary_heap<T>* s, T* e)
+		{
+			if (-1 != e->min_heap_idx)
+			{
+				unsigned idx = static_cast<unsigned>(e->min_heap_idx);
+				dary_heap_entry<T> last = s->p[--s->n];
+				if (idx != s->n)
+				{
+					unsigned parent = (idx - 1) / DARY_HEAP_ARITY;
+					if (idx > 0 && s->p[parent].key > last.key)
+						dary_heap_shift_up_(s, idx, last);
+					else
+						dary_heap_shift_down_(s, idx, last);
+				}
+				e->min_heap_idx = -1;
+				return 0;
+			}
+			return -1;
+		}
+
+		template <typename T>
+		int dary_heap_reserve(dary_heap<T>* s, unsigned n)
+		{
+			if (s->a < n)
+			{
+				unsigned a = s->a ? s->a * 2 : 16;
+				if (a < n)
+					a = n;
+
+				void* mem = malloc(a * sizeof(dary_heap_entry<T>) + 2 * DARY_HEAP_LINE);
+				if (!mem)
+					return -1;
+
+				//! align so that p[1] starts a cache line, root sits at the end of the line before
+				uintptr_t line = (reinterpret_cast<uintptr_t>(mem) + DARY_HEAP_LINE - 1) & ~uintptr_t(DARY_HEAP_LINE - 1);
+				dary_heap_entry<T>* p = reinterpret_cast<dary_heap_entry<T>*>(line + DARY_HEAP_LINE) - 1;
+				if (s->n)
+					memcpy(p, s->p, s->n * sizeof(dary_heap_entry<T>));
+				if (s->mem)
+					free(s->mem);
+
+				s->mem = mem;
+				s->p = p;
+				s->a = a;
+			}
+			return 0;
+		}
+
+		//! restore e's position after its key changed, -1 if e isn't in the heap
+		template <typename T>
+		int dary_heap_adjust(dary_heap<T>* s, T* e)
+		{
+			if (-1 != e->min_heap_idx)
+			{
+				unsigned idx = static_cast<unsigned>(e->min_heap_idx);
+				dary_heap_entry<T> x = { dary_heap_elem_key(e), e };
+				unsigned parent = (idx - 1) / DARY_HEAP_ARITY;
+				if (idx > 0 && s->p[parent].key > x.key)
+					dary_heap_shift_up_(s, idx, x);
+				else
+					dary_heap_shift_down_(s, idx, x);
+				return 0;
+			}
+			return -1;
+		}
+
+		//! store at the end without sifting (room must be reserved), dary_heap_heapify restores the order
+		template <typename T>
+		void dary_heap_append(dary_heap<T>* s, T* e)
+		{
+			dary_heap_entry<T> x = { dary_heap_elem_key(e), e };
+			(s->p[s->n] = x).e->min_heap_idx = s->n;
+			++s->n;
+		}
+
+		//! restore heap order after appending [from, n): rebuilt bottom-up in O(n) when the batch
+		//! outweighs the old heap, otherwise each new element is sifted up
+		template <typename T>
+		void dary_heap_heapify(dary_heap<T>* s, unsigned from)
+		{
+			if (s->n - from > from)
+			{
+				if (s->n > 1)
+					dary_heap_build_(s, 0u, (s->n + DARY_HEAP_ARITY - 2) / DARY_HEAP_ARITY);
+			}
+			else
+			{
+				for (unsigned i = from; i < s->n; ++i)
+					dary_heap_shift_up_(s, i, s->p[i]);
+			}
+		}
+
+		//! drop every element fn returns nonzero for (fn may dispose of it) and rebuild in O(n),
+		//! returns the number dropped
+		template <typename T, typename F>
+		unsigned dary_heap_sweep(dary_heap<T>* s, F fn)
+		{
+			unsigned n = 0;
+			for (unsigned i = 0; i < s->n; ++i)
+			{
+				dary_heap_entry<T> x = s->p[i];
+				x.e->min_heap_idx = -1;
+				if (!fn(x.e))
+				{
+					(s->p[n] = x).e->min_heap_idx = n;
+					++n;
+				}
+			}
+			unsigned dropped = s->n - n;
+			s->n = n;
+			dary_heap_heapify(s, 0u);
+			return dropped;
+		}
+
+		//! sum of fn over the elements keyed below key, only they and their children are visited
+		template <typename T, typename F>
+		unsigned dary_heap_count_below(dary_heap<T>* s, int64_t key, F fn)
+		{
+			return s->n ? dary_heap_count_below_(s, 0u, key, fn) : 0u;
+		}
+
+		template <typename T, typename F>
+		unsigned dary_heap_count_below_(dary_heap<T>* s, unsigned index, int64_t key, F& fn)
+		{
+			if (!(s->p[index].key < key))
+				return 0;
+			unsigned n = fn(s->p[index].e);
+			unsigned first = index * DARY_HEAP_ARITY + 1;
+			for (unsigned i = first; i < first + DARY_HEAP_ARITY && i < s->n; ++i)
+				n += dary_heap_count_below_(s, i, key, fn);
+			return n;
+		}
+
+		//! floyd's construction in post order, each subtree is finished while its lines are still cached
+		template <typename T>
+		void dary_heap_build_(dary_heap<T>* s, unsigned index, unsigned parents)
+		{
+			unsigned first = index * DARY_HEAP_ARITY + 1;
+			for (unsigned i = first; i < first + DARY_HEAP_ARITY && i < parents; ++i)
+				dary_heap_build_(s, i, parents);
+			dary_heap_shift_down_(s, index, s->p[index]);
+		}
+
+		template <typename T>
+		void dary_heap_shift_up_(dary_heap<T>* s, unsigned hole_index, dary_heap_entry<T> x)
+		{
+			while (hole_index)
+			{
+				unsigned parent = (hole_index - 1) / DARY_HEAP_ARITY;
+				if (!(s->p[parent].key > x.key))
+					break;
+				(s->p[hole_index] = s->p[parent]).e->min_heap_idx = hole_index;
+				hole_index = parent;
+			}
+			(s->p[hole_index] = x).e->min_heap_idx = hole_index;
+		}
+
+		template <typename T>
+		void dary_heap_shift_down_(dary_heap<T>* s, unsigned hole_index, dary_heap_entry<T> x)
+		{
+			for (;;)
+			{
+				unsigned first = hole_index * DARY_HEAP_ARITY + 1;
+				if (first >= s->n)
+					break;
+
+				unsigned last = first + DARY_HEAP_ARITY < s->n ? first + DARY_HEAP_ARITY : s->n;
+				unsigned min_child = first;
+				int64_t min_key = s->p[first].key;
+				for (unsigned i = first + 1; i < last; ++i)
+				{
+					if (s->p[i].key < min_key)
+					{
+						min_child = i;
+						min_key = s->p[i].key;
+					}
+				}
+
+				if (!(x.key > min_key))
+					break;
+				(s->p[hole_index] = s->p[min_child]).e->min_heap_idx = hole_index;
+				hole_index = min_child;
+			}
+			(s->p[hole_index] = x).e->min_heap_idx = hole_index;
+		}
+	}
+}
+
+#endif
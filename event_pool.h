@@ -0,0 +1,192 @@
+#ifndef _EVENT_POOL_HEADER_
+#define _EVENT_POOL_HEADER_
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <vector>
+
+namespace gsf
+{
+	namespace utils
+	{
+		/**!
+			timer id
+			generation (24 bits) | shard (8 bits) | pool slot (32 bits).
+			a slot's generation changes every time it is released, so an id kept
+			after its event fired or was removed no longer resolves. the shard names
+			the Timer that owns the slot. 0 is never valid.
+		*/
+		typedef uint64_t TimerID;
+
+		enum
+		{
+			TIMER_ID_GENERATION_MASK = 0xffffff,
+		};
+
+		inline TimerID make_timer_id(uint32_t index, uint32_t generation, uint32_t shard)
+		{
+			return (static_cast<uint64_t>(generation & TIMER_ID_GENERATION_MASK) << 40) | (static_cast<uint64_t>(shard & 0xff) << 32) | index;
+		}
+
+		inline uint32_t timer_id_index(TimerID id) { return static_cast<uint32_t>(id); }
+
+		inline uint32_t timer_id_shard(TimerID id) { return static_cast<uint32_t>(id >> 32) & 0xff; }
+
+		inline uint32_t timer_id_generation(TimerID id) { return static_cast<uint32_t>(id >> 40); }
+
+		/**!
+			event pool
+			slab allocator for timer events. slots are carved out of fixed size chunks
+			that never move, so the queues may keep raw pointers while the pool grows.
+			released slots go on a free list and are handed out again (LIFO), so after
+			warm up alloc / free don't touch malloc.
+			only the owning thread allocates and frees. other threads may resolve a
+			slot with event_pool_slot: the chunk table is published atomically and a
+			replaced table stays alive until the pool is destroyed.
+		*/
+
+		enum
+		{
+			EVENT_POOL_CHUNK_BITS = 10,
+			EVENT_POOL_CHUNK_SIZE = 1 << EVENT_POOL_CHUNK_BITS,
+		};
+
+		template <typename T>
+		struct event_pool
+		{
+			std::atomic<T**> chunks;		//! chunk table
+			std::atomic<uint32_t> n;		//! slots carved so far
+			uint32_t chunk_count;
+			uint32_t chunk_cap;
+			uint32_t used;					//! slots handed out
+			std::vector<T**> tables;		//! every chunk table ever published
+			std::vector<uint32_t> free_slots;
+		};
+
+		template <typename T>
+		static inline void	     event_pool_ctor(event_pool<T>* s);
+
+		template <typename T>
+		static inline void	     event_pool_dtor(event_pool<T>* s);
+
+		template <typename T>
+		static inline T*		 event_pool_at(event_pool<T>* s, uint32_t index);
+
+		template <typename T>
+		static inline T*		 event_pool_alloc(event_pool<T>* s);
+
+		template <typename T>
+		static inline void	     event_pool_free(event_pool<T>* s, T* e);
+
+		template <typename T>
+		static inline T*		 event_pool_get(event_pool<T>* s, TimerID id);
+
+		template <typename T>
+		static inline T*		 event_pool_slot(event_pool<T>* s, uint32_t index);
+
+		//! the id of e in the pool of the given shard
+		template <typename T>
+		static inline TimerID	 event_pool_id(const T* e, uint32_t shard);
+
+		template <typename T>
+		void event_pool_ctor(event_pool<T>* s)
+		{
+			s->chunks.store(0, std::memory_order_relaxed);
+			s->n.store(0, std::memory_order_relaxed);
+			s->chunk_count = 0;
+			s->chunk_cap = 0;
+			s->used = 0;
+		}
+
+		template <typename T>
+		void event_pool_dtor(event_pool<T>* s)
+		{
+			T** table = s->chunks.load(std::memory_order_relaxed);
+			for (uint32_t i = 0; i < s->chunk_count; ++i)
+				delete[] table[i];
+			for (size_t i = 0; i < s->tables.size(); ++i)
+				delete[] s->tables[i];
+			s->tables.clear();
+			s->free_slots.clear();
+			event_pool_ctor(s);
+		}
+
+		template <typename T>
+		T* event_pool_at(event_pool<T>* s, uint32_t index)
+		{
+			return &s->chunks.load(std::memory_order_acquire)[index >> EVENT_POOL_CHUNK_BITS][index & (EVENT_POOL_CHUNK_SIZE - 1)];
+		}
+
+		template <typename T>
+		T* event_pool_alloc(event_pool<T>* s)
+		{
+			T* e;
+			if (!s->free_slots.empty())
+			{
+				e = event_pool_at(s, s->free_slots.back());
+				s->free_slots.pop_back();
+			}
+			else
+			{
+				uint32_t index = s->n.load(std::memory_order_relaxed);
+				if (index == s->chunk_count * EVENT_POOL_CHUNK_SIZE)
+				{
+					if (s->chunk_count == s->chunk_cap)
+					{
+						uint32_t cap = s->chunk_cap ? s->chunk_cap * 2 : 16;
+						T** table = new T*[cap]();
+						if (s->chunk_count)
+							memcpy(table, s->chunks.load(std::memory_order_relaxed), s->chunk_count * sizeof(T*));
+						s->tables.push_back(table);
+						s->chunks.store(table, std::memory_order_release);
+						s->chunk_cap = cap;
+					}
+					s->chunks.load(std::memory_order_relaxed)[s->chunk_count++] = new T[EVENT_POOL_CHUNK_SIZE]();
+				}
+
+				e = event_pool_at(s, index);
+				e->pool_idx = index;
+				e->generation = 1;
+				s->n.store(index + 1, std::memory_order_release);
+			}
+			++s->used;
+			return e;
+		}
+
+		template <typename T>
+		void event_pool_free(event_pool<T>* s, T* e)
+		{
+			e->generation = (e->generation + 1) & TIMER_ID_GENERATION_MASK;
+			if (0 == e->generation)
+				e->generation = 1;
+			s->free_slots.push_back(e->pool_idx);
+			--s->used;
+		}
+
+		template <typename T>
+		T* event_pool_get(event_pool<T>* s, TimerID id)
+		{
+			T* e = event_pool_slot(s, timer_id_index(id));
+			if (!e || e->generation != timer_id_generation(id))
+				return 0;
+			return e;
+		}
+
+		template <typename T>
+		T* event_pool_slot(event_pool<T>* s, uint32_t index)
+		{
+			if (index >= s->n.load(std::memory_order_acquire))
+				return 0;
+			return event_pool_at(s, index);
+		}
+
+		template <typename T>
+		TimerID event_pool_id(const T* e, uint32_t shard)
+		{
+			return make_timer_id(e->pool_idx, e->generation, shard);
+		}
+	}
+}
+
+#endif
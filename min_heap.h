@@ -1,6 +1,8 @@
 #ifndef _MINHEAP_HEADER_
 #define _MINHEAP_HEADER_
 
+#include <stdint.h>
+#include <stdlib.h>
 
 namespace gsf
 {
@@ -53,6 +55,27 @@ namespace gsf
 		template <typename T>
 		static inline int	     min_heap_erase(min_heap<T>* s, T* e);
 
+		template <typename T>
+		static inline int	     min_heap_adjust(min_heap<T>* s, T* e);
+
+		template <typename T>
+		static inline void	     min_heap_append(min_heap<T>* s, T* e);
+
+		template <typename T>
+		static inline void	     min_heap_heapify(min_heap<T>* s, unsigned from);
+
+		template <typename T, typename F>
+		static inline unsigned	 min_heap_sweep(min_heap<T>* s, F fn);
+
+		template <typename T, typename F>
+		static inline unsigned	 min_heap_count_below(min_heap<T>* s, int64_t key, F fn);
+
+		template <typename T, typename F>
+		static inline unsigned	 min_heap_count_below_(min_heap<T>* s, unsigned index, int64_t key, F& fn);
+
+		template <typename T>
+		static inline void	     min_heap_build_(min_heap<T>* s, unsigned index, unsigned parents);
+
 		template <typename T>
 		static inline void	     min_heap_shift_up_(min_heap<T>* s, unsigned hole_index, T* e);
 
@@ -146,6 +169,106 @@ namespace gsf
 			return 0;
 		}
 
+		//! restore e's position after its key changed, -1 if e isn't in the heap
+		template <typename T>
+		int min_heap_adjust(min_heap<T>* s, T* e)
+		{
+			if (-1 != e->min_heap_idx)
+			{
+				unsigned idx = static_cast<unsigned>(e->min_heap_idx);
+				unsigned parent = (idx - 1) / 2;
+				if (idx > 0 && min_heap_elem_greater(s->p[parent], e))
+					min_heap_shift_up_(s, idx, e);
+				else
+					min_heap_shift_down_(s, idx, e);
+				return 0;
+			}
+			return -1;
+		}
+
+		//! store at the end without sifting (room must be reserved), min_heap_heapify restores the order
+		template <typename T>
+		void min_heap_append(min_heap<T>* s, T* e)
+		{
+			(s->p[s->n] = e)->min_heap_idx = s->n;
+			++s->n;
+		}
+
+		//! restore heap order after appending [from, n): rebuilt bottom-up in O(n) when the batch
+		//! outweighs the old heap, otherwise each new element is sifted up
+		template <typename T>
+		void min_heap_heapify(min_heap<T>* s, unsigned from)
+		{
+			if (s->n - from > from)
+			{
+				if (s->n > 1)
+					min_heap_build_(s, 0u, s->n / 2);
+			}
+			else
+			{
+				for (unsigned i = from; i < s->n; ++i)
+					min_heap_shift_up_(s, i, s->p[i]);
+			}
+		}
+
+		//! drop every element fn returns nonzero for (fn may dispose of it) and rebuild in O(n),
+		//! returns the number dropped
+		template <typename T, typename F>
+		unsigned min_heap_sweep(min_heap<T>* s, F fn)
+		{
+			unsigned n = 0;
+			for (unsigned i = 0; i < s->n; ++i)
+			{
+				T* e = s->p[i];
+				e->min_heap_idx = -1;
+				if (!fn(e))
+				{
+					(s->p[n] = e)->min_heap_idx = n;
+					++n;
+				}
+			}
+			unsigned dropped = s->n - n;
+			s->n = n;
+			min_heap_heapify(s, 0u);
+			return dropped;
+		}
+
+		//! sum of fn over the elements keyed below key, only they and their children are visited
+		template <typename T, typename F>
+		unsigned min_heap_count_below(min_heap<T>* s, int64_t key, F fn)
+		{
+			return s->n ? min_heap_count_below_(s, 0u, key, fn) : 0u;
+		}
+
+		template <typename T, typename F>
+		unsigned min_heap_count_below_(min_heap<T>* s, unsigned index, int64_t key, F& fn)
+		{
+			if (!(s->p[index]->tp_ < key))
+				return 0;
+			unsigned n = fn(s->p[index]);
+			unsigned child = 2 * index + 1;
+			if (child < s->n)
+				n += min_heap_count_below_(s, child, key, fn);
+			if (child + 1 < s->n)
+				n += min_heap_count_below_(s, child + 1, key, fn);
+			return n;
+		}
+
+		//! floyd's construction in post order: a subtree is sifted right after its children,
+		//! while they are still in cache, instead of level by level across the whole array
+		template <typename T>
+		void min_heap_build_(min_heap<T>* s, unsigned index, unsigned parents)
+		{
+			unsigned child = 2 * index + 1;
+			if (child < parents)
+			{
+				min_heap_build_(s, child, parents);
+				if (child + 1 < parents)
+					min_heap_build_(s, child + 1, parents);
+			}
+			min_heap_shift_down_(s, index, s->p[index]);
+		}
+
 		template <typename T>
 		void min_heap_shift_up_(min_heap<T>* s, unsigned hole_index, T* e)
 		{
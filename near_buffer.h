@@ -0,0 +1,373 @@
+#ifndef _NEAR_BUFFER_HEADER_
+#define _NEAR_BUFFER_HEADER_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define NEAR_BUFFER_X86 1
+#endif
+
+namespace gsf
+{
+	namespace utils
+	{
+		/**!
+			near buffer
+			staging area for elements due within a few ms. deadlines sit unsorted in a
+			flat int64_t array, push and erase are O(1) (swap with the last), and one
+			pass compares the whole array against now (AVX2 or SSE4.2, chosen at run
+			time, scalar otherwise) to pull out everything expired. the expired
+			elements are sorted among themselves and handed out in deadline order
+			from a ready list, so a heap behind the buffer can be merged with it.
+
+			e->near_idx is >= 0 in the array, <= -2 in the ready list (-2 - position)
+			and -1 elsewhere.
+		*/
+
+		template <typename T>
+		struct near_buffer
+		{
+			int64_t* keys;		//! 32 byte aligned
+			T** elems;
+			uint32_t* hits;		//! scratch for near_buffer_scan_
+			unsigned n, a;
+
+			T** ready;			//! expired, sorted, nullptr where an element was erased
+			unsigned ready_head, ready_n;
+			unsigned ready_live;	//! non null entries in ready[ready_head, ready_n)
+			int64_t scanned;	//! now of the last scan, INT64_MIN forces the next one
+			void* mem;
+		};
+
+		typedef unsigned(*near_buffer_scan_fn)(const int64_t* keys, unsigned n, int64_t now, uint32_t* hits);
+
+		template <typename T>
+		static inline int	     near_buffer_ctor(near_buffer<T>* b, unsigned capacity);
+
+		template <typename T>
+		static inline void	     near_buffer_dtor(near_buffer<T>* b);
+
+		template <typename T>
+		static inline void	     near_buffer_elem_init(T* e);
+
+		template <typename T>
+		static inline int	     near_buffer_full(near_buffer<T>* b);
+
+		template <typename T>
+		static inline unsigned	 near_buffer_size(near_buffer<T>* b);
+
+		template <typename T>
+		static inline void	     near_buffer_push(near_buffer<T>* b, T* e);
+
+		template <typename T>
+		static inline int	     near_buffer_erase(near_buffer<T>* b, T* e);
+
+		//! earliest element with a key below now, nullptr if none. stays queued until near_buffer_pop
+		template <typename T>
+		static inline T*		 near_buffer_top(near_buffer<T>* b, int64_t now);
+
+		//! remove what near_buffer_top returned
+		template <typename T>
+		static inline T*		 near_buffer_pop(near_buffer<T>* b);
+
+		//! smallest key, INT64_MAX if empty
+		template <typename T>
+		static inline int64_t	 near_buffer_min(near_buffer<T>* b);
+
+		template <typename T, typename F>
+		static inline unsigned	 near_buffer_sweep(near_buffer<T>* b, F fn);
+
+		template <typename T, typename F>
+		static inline unsigned	 near_buffer_count_below(near_buffer<T>* b, int64_t key, F fn);
+
+		template <typename T>
+		static inline void	     near_buffer_scan_(near_buffer<T>* b, int64_t now);
+
+		static inline unsigned	 near_buffer_scan_scalar_(const int64_t* keys, unsigned n, int64_t now, uint32_t* hits);
+
+		static inline near_buffer_scan_fn near_buffer_select_();
+
+		template <typename T>
+		int near_buffer_ctor(near_buffer<T>* b, unsigned capacity)
+		{
+			//! keys padded to a whole vector so the scan never reads past the allocation
+			unsigned keys = (capacity + 3) & ~3u;
+			size_t size = keys * sizeof(int64_t) + 2 * capacity * sizeof(T*) + capacity * sizeof(uint32_t) + 32;
+			b->mem = malloc(size);
+			if (!b->mem)
+			{
+				memset(b, 0, sizeof(*b));
+				return -1;
+			}
+
+			uintptr_t p = (reinterpret_cast<uintptr_t>(b->mem) + 31) & ~uintptr_t(31);
+			b->keys = reinterpret_cast<int64_t*>(p);
+			memset(b->keys, 0, keys * sizeof(int64_t));
+			b->elems = reinterpret_cast<T**>(b->keys + keys);
+			b->ready = b->elems + capacity;
+			b->hits = reinterpret_cast<uint32_t*>(b->ready + capacity);
+			b->n = 0;
+			b->a = capacity;
+			b->ready_head = b->ready_n = b->ready_live = 0;
+			b->scanned = INT64_MIN;
+			return 0;
+		}
+
+		template <typename T>
+		void near_buffer_dtor(near_buffer<T>* b) { if (b->mem) free(b->mem); }
+
+		template <typename T>
+		void near_buffer_elem_init(T* e) { e->near_idx = -1; }
+
+		template <typename T>
+		int near_buffer_full(near_buffer<T>* b) { return b->n + b->ready_n >= b->a; }
+
+		template <typename T>
+		unsigned near_buffer_size(near_buffer<T>* b) { return b->n + b->ready_live; }
+
+		template <typename T>
+		void near_buffer_push(near_buffer<T>* b, T* e)
+		{
+			b->keys[b->n] = e->tp_;
+			b->elems[b->n] = e;
+			e->near_idx = static_cast<int32_t>(b->n++);
+
+			//! already due at the last scan, it must not wait for the clock to move
+			if (e->tp_ < b->scanned)
+				b->scanned = INT64_MIN;
+		}
+
+		template <typename T>
+		int near_buffer_erase(near_buffer<T>* b, T* e)
+		{
+			if (e->near_idx >= 0)
+			{
+				unsigned idx = static_cast<unsigned>(e->near_idx);
+				if (idx != --b->n)
+				{
+					b->keys[idx] = b->keys[b->n];
+					b->elems[idx] = b->elems[b->n];
+					b->elems[idx]->near_idx = static_cast<int32_t>(idx);
+				}
+				e->near_idx = -1;
+				return 0;
+			}
+			if (e->near_idx <= -2)
+			{
+				b->ready[-2 - e->near_idx] = 0;
+				--b->ready_live;
+				e->near_idx = -1;
+				return 0;
+			}
+			return -1;
+		}
+
+		template <typename T>
+		T* near_buffer_top(near_buffer<T>* b, int64_t now)
+		{
+			if (now != b->scanned)
+				near_buffer_scan_(b, now);
+
+			while (b->ready_head < b->ready_n && !b->ready[b->ready_head])
+				++b->ready_head;
+			if (b->ready_head < b->ready_n)
+				return b->ready[b->ready_head];
+
+			b->ready_head = b->ready_n = 0;
+			return 0;
+		}
+
+		template <typename T>
+		T* near_buffer_pop(near_buffer<T>* b)
+		{
+			T* e = b->ready[b->ready_head++];
+			--b->ready_live;
+			e->near_idx = -1;
+			return e;
+		}
+
+		template <typename T>
+		int64_t near_buffer_min(near_buffer<T>* b)
+		{
+			int64_t key = INT64_MAX;
+			for (unsigned i = 0; i < b->n; ++i)
+				key = b->keys[i] < key ? b->keys[i] : key;
+			for (unsigned i = b->ready_head; i < b->ready_n; ++i)
+			{
+				if (b->ready[i])
+				{
+					key = b->ready[i]->tp_ < key ? b->ready[i]->tp_ : key;
+					break;
+				}
+			}
+			return key;
+		}
+
+		//! drop every element fn returns nonzero for (fn may dispose of it), returns the number dropped
+		template <typename T, typename F>
+		unsigned near_buffer_sweep(near_buffer<T>* b, F fn)
+		{
+			unsigned dropped = 0;
+			unsigned n = 0;
+			for (unsigned i = 0; i < b->n; ++i)
+			{
+				T* e = b->elems[i];
+				e->near_idx = -1;
+				if (fn(e))
+				{
+					++dropped;
+					continue;
+				}
+				b->keys[n] = b->keys[i];
+				b->elems[n] = e;
+				e->near_idx = static_cast<int32_t>(n++);
+			}
+			b->n = n;
+
+			for (unsigned i = b->ready_head; i < b->ready_n; ++i)
+			{
+				T* e = b->ready[i];
+				if (!e)
+					continue;
+				e->near_idx = -1;
+				if (fn(e))
+				{
+					b->ready[i] = 0;
+					--b->ready_live;
+					++dropped;
+					continue;
+				}
+				e->near_idx = -2 - static_cast<int32_t>(i);
+			}
+			return dropped;
+		}
+
+		//! sum of fn over the elements keyed below key
+		template <typename T, typename F>
+		unsigned near_buffer_count_below(near_buffer<T>* b, int64_t key, F fn)
+		{
+			unsigned n = 0;
+			for (unsigned i = 0; i < b->n; ++i)
+			{
+				if (b->keys[i] < key)
+					n += fn(b->elems[i]);
+			}
+			for (unsigned i = b->ready_head; i < b->ready_n; ++i)
+			{
+				if (b->ready[i] && b->ready[i]->tp_ < key)
+					n += fn(b->ready[i]);
+			}
+			return n;
+		}
+
+		template <typename T>
+		void near_buffer_scan_(near_buffer<T>* b, int64_t now)
+		{
+			b->scanned = now;
+
+			static const near_buffer_scan_fn scan = near_buffer_select_();
+			unsigned hits = scan(b->keys, b->n, now, b->hits);
+			if (!hits)
+				return;
+
+			//! keep what is left of the last batch (an update that ran out of budget)
+			unsigned ready = 0;
+			for (unsigned i = b->ready_head; i < b->ready_n; ++i)
+			{
+				if (b->ready[i])
+					b->ready[ready++] = b->ready[i];
+			}
+
+			//! descending, so the last element swapped in is never one still to be taken
+			while (hits--)
+			{
+				unsigned idx = b->hits[hits];
+				b->ready[ready++] = b->elems[idx];
+				if (idx != --b->n)
+				{
+					b->keys[idx] = b->keys[b->n];
+					b->elems[idx] = b->elems[b->n];
+					b->elems[idx]->near_idx = static_cast<int32_t>(idx);
+				}
+			}
+
+			std::sort(b->ready, b->ready + ready, [](const T* x, const T* y) { return x->tp_ < y->tp_; });
+			for (unsigned i = 0; i < ready; ++i)
+				b->ready[i]->near_idx = -2 - static_cast<int32_t>(i);
+			b->ready_head = 0;
+			b->ready_n = b->ready_live = ready;
+		}
+
+		unsigned near_buffer_scan_scalar_(const int64_t* keys, unsigned n, int64_t now, uint32_t* hits)
+		{
+			unsigned count = 0;
+			for (unsigned i = 0; i < n; ++i)
+			{
+				hits[count] = i;
+				count += keys[i] < now ? 1 : 0;
+			}
+			return count;
+		}
+
+#if defined(NEAR_BUFFER_X86)
+		__attribute__((target("avx2")))
+		static inline unsigned near_buffer_scan_avx2_(const int64_t* keys, unsigned n, int64_t now, uint32_t* hits)
+		{
+			unsigned count = 0;
+			__m256i vnow = _mm256_set1_epi64x(now);
+			for (unsigned i = 0; i < n; i += 4)
+			{
+				//! now > key, lanes past n read the padding and are masked off below
+				__m256i vkey = _mm256_load_si256(reinterpret_cast<const __m256i*>(keys + i));
+				unsigned mask = static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(vnow, vkey))));
+				if (n - i < 4)
+					mask &= (1u << (n - i)) - 1;
+				while (mask)
+				{
+					hits[count++] = i + static_cast<unsigned>(__builtin_ctz(mask));
+					mask &= mask - 1;
+				}
+			}
+			return count;
+		}
+
+		__attribute__((target("sse4.2")))
+		static inline unsigned near_buffer_scan_sse42_(const int64_t* keys, unsigned n, int64_t now, uint32_t* hits)
+		{
+			unsigned count = 0;
+			__m128i vnow = _mm_set1_epi64x(now);
+			for (unsigned i = 0; i < n; i += 2)
+			{
+				__m128i vkey = _mm_load_si128(reinterpret_cast<const __m128i*>(keys + i));
+				unsigned mask = static_cast<unsigned>(_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(vnow, vkey))));
+				if (n - i < 2)
+					mask &= 1u;
+				while (mask)
+				{
+					hits[count++] = i + static_cast<unsigned>(__builtin_ctz(mask));
+					mask &= mask - 1;
+				}
+			}
+			return count;
+		}
+#endif
+
+		near_buffer_scan_fn near_buffer_select_()
+		{
+#if defined(NEAR_BUFFER_X86)
+			__builtin_cpu_init();
+			if (__builtin_cpu_supports("avx2"))
+				return &near_buffer_scan_avx2_;
+			if (__builtin_cpu_supports("sse4.2"))
+				return &near_buffer_scan_sse42_;
+#endif
+			return &near_buffer_scan_scalar_;
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,284 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "basic_timer.h"
+
+#include <random>
+#include <vector>
+#include <algorithm>
+
+/**!
+	queue policy fuzz
+	g++ -O2 -std=c++11 queue_fuzz.cpp -o queue_fuzz
+	./queue_fuzz [seeds, default 300] [steps per seed, default 3000]
+
+	drives one random add / rmv / reschedule / update sequence through a
+	BasicTimer per queue policy (min heap, d-ary heap, radix heap, timing wheel)
+	on a synthetic clock, and checks each of them against a reference model:
+	the same return codes, the same timers fired in deadline order on every
+	update(), the same next_deadline(). the wheel's next_deadline() is a lower
+	bound not earlier than now for timers it hasn't cascaded yet. the exit code
+	is the number of failed seeds.
+*/
+
+using namespace gsf::utils;
+
+struct fuzz_clock
+{
+	static int64_t now() { return 1000000; }
+};
+
+struct fuzz_run;
+
+struct fuzz_callback
+{
+	fuzz_run *run;
+	int tag;
+
+	void operator()();
+};
+
+//! a periodic timer moves itself on every third firing, offset by its tag
+static bool fuzz_self_moves(int fires) { return fires % 3 == 0; }
+static uint32_t fuzz_self_offset(int tag) { return static_cast<uint32_t>(tag * 7 % 40); }
+
+struct fuzz_run
+{
+	const char *name;
+	std::vector<TimerID> ids;	//! by tag
+	std::vector<int> fires;		//! by tag
+	std::vector<int> fired;		//! tags fired by the last update()
+
+	virtual ~fuzz_run() {}
+	virtual TimerID add(uint32_t delay, uint32_t period, int tag) = 0;
+	virtual int rmv(TimerID id) = 0;
+	virtual int reschedule(TimerID id, uint32_t delay) = 0;
+	virtual void update(int64_t now) = 0;
+	virtual int64_t next_deadline() = 0;
+	virtual bool deadline_ok(int64_t got, int64_t want, int64_t now) = 0;
+};
+
+void fuzz_callback::operator()()
+{
+	run->fired.push_back(tag);
+	if (fuzz_self_moves(++run->fires[tag])){
+		run->reschedule(run->ids[tag], fuzz_self_offset(tag));
+	}
+}
+
+template <template <typename> class Queue>
+struct fuzz_queue : public fuzz_run
+{
+	BasicTimer<fuzz_callback, Queue> timer;
+
+	explicit fuzz_queue(const char *n)
+	{
+		name = n;
+		timer.template use_clock<fuzz_clock>();
+	}
+
+	TimerID add(uint32_t delay, uint32_t period, int tag)
+	{
+		fuzz_callback _callback = { this, tag };
+		if (period){
+			return timer.add_timer(delay_repeat(period, delay), _callback);
+		}
+		return timer.add_timer(delay_milliseconds(delay), _callback);
+	}
+
+	int rmv(TimerID id) { return timer.rmv_timer(id); }
+	int reschedule(TimerID id, uint32_t delay) { return timer.reschedule(id, delay_milliseconds(delay)); }
+	void update(int64_t now) { timer.update(now); }
+	int64_t next_deadline() { return timer.next_deadline(); }
+	bool deadline_ok(int64_t got, int64_t want, int64_t) { return got == want; }
+};
+
+//! timers not cascaded down yet are only bounded by the start of their slot
+template <>
+bool fuzz_queue<timing_wheel_queue>::deadline_ok(int64_t got, int64_t want, int64_t now)
+{
+	return want == INT64_MAX ? got == want : got <= want && got >= now;
+}
+
+//! the reference: what every policy has to agree on
+struct fuzz_model
+{
+	std::vector<int64_t> due;		//! by tag, -1 once released
+	std::vector<int64_t> period;
+	std::vector<int> fires;
+
+	int64_t next_deadline() const
+	{
+		int64_t _next = INT64_MAX;
+		for (size_t i = 0; i < due.size(); ++i)
+		{
+			if (due[i] >= 0 && due[i] < _next){
+				_next = due[i];
+			}
+		}
+		return _next;
+	}
+};
+
+static uint32_t fuzz_delay(std::mt19937 &rng)
+{
+	switch (rng() % 8)
+	{
+	case 0: return rng() % 100000;
+	case 1: return rng() % (1u << 26);
+	default: return rng() % 50;
+	}
+}
+
+static bool fuzz_seed(unsigned seed, int steps)
+{
+	std::mt19937 _rng(seed);
+	fuzz_queue<min_heap_queue> _min("min_heap");
+	fuzz_queue<dary_heap_queue> _dary("dary_heap");
+	fuzz_queue<radix_heap_queue> _radix("radix_heap");
+	fuzz_queue<timing_wheel_queue> _wheel("timing_wheel");
+	fuzz_run *_runs[] = { &_min, &_dary, &_radix, &_wheel };
+	const int _run_n = sizeof(_runs) / sizeof(_runs[0]);
+
+	fuzz_model _model;
+	int64_t _now = fuzz_clock::now();
+
+	for (int step = 0; step < steps; ++step)
+	{
+		int _op = _rng() % 10;
+		if (_op < 4)
+		{
+			uint32_t _delay = fuzz_delay(_rng);
+			uint32_t _period = _rng() % 6 ? 0 : 1 + _rng() % 30;
+			int _tag = static_cast<int>(_model.due.size());
+			_model.due.push_back(_now + _delay);
+			_model.period.push_back(_period);
+			_model.fires.push_back(0);
+
+			for (int r = 0; r < _run_n; ++r)
+			{
+				_runs[r]->ids.push_back(_runs[r]->add(_delay, _period, _tag));
+				_runs[r]->fires.push_back(0);
+				if (!_runs[r]->ids.back())
+				{
+					printf("seed %u step %d: %s add_timer failed\n", seed, step, _runs[r]->name);
+					return false;
+				}
+			}
+		}
+		else if (_op < 7 && !_model.due.empty())
+		{
+			int _tag = static_cast<int>(_rng() % _model.due.size());
+			bool _move = _op == 6;
+			uint32_t _delay = fuzz_delay(_rng);
+			int _want = _model.due[_tag] >= 0 ? 0 : -1;
+
+			for (int r = 0; r < _run_n; ++r)
+			{
+				TimerID _id = _runs[r]->ids[_tag];
+				int _got = _move ? _runs[r]->reschedule(_id, _delay) : _runs[r]->rmv(_id);
+				if (_got != _want)
+				{
+					printf("seed %u step %d: %s %s tag %d returned %d, want %d\n", seed, step, _runs[r]->name, _move ? "reschedule" : "rmv_timer", _tag, _got, _want);
+					return false;
+				}
+			}
+
+			if (_want == 0){
+				_model.due[_tag] = _move ? _now + _delay : -1;
+			}
+		}
+		else
+		{
+			_now += _rng() % 4 ? _rng() % 5 : _rng() % 3000;
+
+			//! due before now fire once each, by deadline. equal deadlines may come in any order
+			std::vector<std::pair<int64_t, int> > _want;
+			for (size_t i = 0; i < _model.due.size(); ++i)
+			{
+				if (_model.due[i] >= 0 && _model.due[i] < _now){
+					_want.push_back(std::make_pair(_model.due[i], static_cast<int>(i)));
+				}
+			}
+			std::sort(_want.begin(), _want.end());
+
+			for (int r = 0; r < _run_n; ++r)
+			{
+				_runs[r]->fired.clear();
+				_runs[r]->update(_now);
+
+				std::vector<std::pair<int64_t, int> > _got;
+				for (size_t i = 0; i < _runs[r]->fired.size(); ++i)
+				{
+					int _tag = _runs[r]->fired[i];
+					_got.push_back(std::make_pair(_model.due[_tag], _tag));
+					if (i && _got[i].first < _got[i - 1].first)
+					{
+						printf("seed %u step %d: %s fired tag %d (%lld) after tag %d (%lld)\n", seed, step, _runs[r]->name,
+							_tag, (long long)_got[i].first, _got[i - 1].second, (long long)_got[i - 1].first);
+						return false;
+					}
+				}
+
+				std::sort(_got.begin(), _got.end());
+				if (_got != _want)
+				{
+					printf("seed %u step %d: %s fired %zu timers, want %zu\n", seed, step, _runs[r]->name, _got.size(), _want.size());
+					return false;
+				}
+			}
+
+			for (size_t i = 0; i < _want.size(); ++i)
+			{
+				int _tag = _want[i].second;
+				int64_t _period = _model.period[_tag];
+				if (!_period)
+				{
+					_model.due[_tag] = -1;
+				}
+				else if (fuzz_self_moves(++_model.fires[_tag]))
+				{
+					_model.due[_tag] = _now + fuzz_self_offset(_tag);
+				}
+				else
+				{
+					//! missed periods are skipped, the phase is kept
+					int64_t _tp = _model.due[_tag] + _period;
+					if (_tp < _now){
+						_tp += (_now - _tp + _period - 1) / _period * _period;
+					}
+					_model.due[_tag] = _tp;
+				}
+			}
+		}
+
+		int64_t _deadline = _model.next_deadline();
+		for (int r = 0; r < _run_n; ++r)
+		{
+			int64_t _got = _runs[r]->next_deadline();
+			if (!_runs[r]->deadline_ok(_got, _deadline, _now))
+			{
+				printf("seed %u step %d: %s next_deadline %lld, want %lld\n", seed, step, _runs[r]->name, (long long)_got, (long long)_deadline);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned seeds = argc > 1 ? static_cast<unsigned>(atoi(argv[1])) : 300;
+	int steps = argc > 2 ? atoi(argv[2]) : 3000;
+
+	int failed = 0;
+	for (unsigned seed = 0; seed < seeds; ++seed)
+	{
+		if (!fuzz_seed(seed, steps)){
+			++failed;
+		}
+	}
+
+	printf("%u seeds, %s\n", seeds, failed ? "FAILED" : "ok");
+	return failed;
+}
@@ -0,0 +1,480 @@
+#ifndef _RADIX_HEAP_HEADER_
+#define _RADIX_HEAP_HEADER_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace gsf
+{
+	namespace utils
+	{
+		/**!
+			radix heap
+			monotone priority queue for integer deadlines. last is a floor no key is
+			below, bucket i > 0 holds the keys whose highest bit differing from last
+			is bit i - 1 and bucket 0 the keys equal to last. push and erase are O(1)
+			and keys are never compared against each other: taking the top empties
+			the lowest occupied bucket into lower ones, so an element moves at most
+			64 times. buckets are arrays of { key, element }, an element keeps its
+			bucket in list_slot and its position in min_heap_idx.
+
+			the floor only advances to an element keyed below the bound passed to
+			radix_heap_top, so a queue polled with now accepts any later push keyed
+			at or above now. a key below the floor (clock moved back) is still
+			taken, at the price of re-bucketing everything once.
+		*/
+
+		enum
+		{
+			RADIX_HEAP_BUCKETS = 65,
+			RADIX_HEAP_STAGE = RADIX_HEAP_BUCKETS,	//! waiting to be placed, see radix_heap_heapify
+			RADIX_HEAP_SLOTS = RADIX_HEAP_BUCKETS + 1,
+		};
+
+		template <typename T>
+		struct radix_heap_entry
+		{
+			uint64_t key;
+			T* e;
+		};
+
+		template <typename T>
+		struct radix_heap_bucket
+		{
+			radix_heap_entry<T>* p;
+			unsigned n, a;
+		};
+
+		template <typename T>
+		struct radix_heap
+		{
+			radix_heap_bucket<T> b[RADIX_HEAP_SLOTS];
+			uint64_t last;		//! floor, keys as radix_heap_elem_key
+			uint64_t mask;		//! bit i - 1 set when bucket i > 0 is occupied
+			uint64_t min;		//! smallest key while min_valid, a bucket not due yet is walked once
+			int min_valid;
+			unsigned n;
+		};
+
+		template <typename T>
+		static inline void	     radix_heap_ctor(radix_heap<T>* s);
+
+		template <typename T>
+		static inline void	     radix_heap_dtor(radix_heap<T>* s);
+
+		template <typename T>
+		static inline void	     radix_heap_elem_init(T* e);
+
+		//! the deadline with the sign bit flipped, unsigned order matches signed order
+		template <typename T>
+		static inline uint64_t	 radix_heap_elem_key(const T* e);
+
+		template <typename T>
+		static inline int	     radix_heap_empty(radix_heap<T>* s);
+
+		template <typename T>
+		static inline unsigned	 radix_heap_size(radix_heap<T>* s);
+
+		template <typename T>
+		static inline int	     radix_heap_push(radix_heap<T>* s, T* e);
+
+		//! earliest element keyed below key, nullptr if none. stays queued until radix_heap_pop
+		template <typename T>
+		static inline T*		 radix_heap_top(radix_heap<T>* s, int64_t key);
+
+		//! remove what radix_heap_top returned
+		template <typename T>
+		static inline T*		 radix_heap_pop(radix_heap<T>* s);
+
+		template <typename T>
+		static inline int	     radix_heap_erase(radix_heap<T>* s, T* e);
+
+		//! move e after its key changed, -1 if e isn't queued
+		template <typename T>
+		static inline int	     radix_heap_adjust(radix_heap<T>* s, T* e);
+
+		//! smallest key, INT64_MAX if empty
+		template <typename T>
+		static inline int64_t	 radix_heap_min(radix_heap<T>* s);
+
+		template <typename T>
+		static inline int	     radix_heap_reserve(radix_heap<T>* s, unsigned n);
+
+		template <typename T>
+		static inline void	     radix_heap_append(radix_heap<T>* s, T* e);
+
+		template <typename T>
+		static inline void	     radix_heap_heapify(radix_heap<T>* s, unsigned from);
+
+		template <typename T, typename F>
+		static inline unsigned	 radix_heap_sweep(radix_heap<T>* s, F fn);
+
+		template <typename T, typename F>
+		static inline unsigned	 radix_heap_count_below(radix_heap<T>* s, int64_t key, F fn);
+
+		template <typename T>
+		static inline int	     radix_heap_grow_(radix_heap_bucket<T>* b, unsigned n);
+
+		template <typename T>
+		static inline void	     radix_heap_link_(radix_heap<T>* s, int slot, radix_heap_entry<T> x);
+
+		template <typename T>
+		static inline void	     radix_heap_unlink_(radix_heap<T>* s, T* e);
+
+		template <typename T>
+		static inline int	     radix_heap_spread_(radix_heap<T>* s, const radix_heap_entry<T>* p, unsigned n);
+
+		template <typename T>
+		static inline int	     radix_heap_rewind_(radix_heap<T>* s, uint64_t key);
+
+		static inline int		 radix_heap_bits_(uint64_t x);
+
+		template <typename T>
+		uint64_t radix_heap_elem_key(const T* e)
+		{
+			return static_cast<uint64_t>(e->tp_) ^ (uint64_t(1) << 63);
+		}
+
+		template <typename T>
+		void radix_heap_ctor(radix_heap<T>* s) { memset(s, 0, sizeof(*s)); }
+
+		template <typename T>
+		void radix_heap_dtor(radix_heap<T>* s)
+		{
+			for (int i = 0; i < RADIX_HEAP_SLOTS; ++i)
+			{
+				if (s->b[i].p)
+					free(s->b[i].p);
+			}
+		}
+
+		template <typename T>
+		void radix_heap_elem_init(T* e) { e->list_slot = -1; e->min_heap_idx = -1; }
+
+		template <typename T>
+		int radix_heap_empty(radix_heap<T>* s) { return 0u == s->n; }
+
+		template <typename T>
+		unsigned radix_heap_size(radix_heap<T>* s) { return s->n; }
+
+		template <typename T>
+		int radix_heap_push(radix_heap<T>* s, T* e)
+		{
+			radix_heap_entry<T> x = { radix_heap_elem_key(e), e };
+			if (x.key < s->last && radix_heap_rewind_(s, x.key))
+				return -1;
+
+			int i = radix_heap_bits_(x.key ^ s->last);
+			if (radix_heap_grow_(&s->b[i], s->b[i].n + 1))
+				return -1;
+			radix_heap_link_(s, i, x);
+			++s->n;
+			if (s->min_valid && x.key < s->min)
+				s->min = x.key;
+			return 0;
+		}
+
+		template <typename T>
+		T* radix_heap_top(radix_heap<T>* s, int64_t key)
+		{
+			uint64_t limit = static_cast<uint64_t>(key) ^ (uint64_t(1) << 63);
+			if (s->b[RADIX_HEAP_STAGE].n)
+				radix_heap_heapify(s, 0u);
+
+			if (!s->b[0].n)
+			{
+				if (!s->mask || (s->min_valid && s->min >= limit))
+					return 0;
+
+				int i = radix_heap_bits_(s->mask & (~s->mask + 1));
+				uint64_t bit = uint64_t(1) << (i - 1);
+				if (((s->last | bit) & ~(bit - 1)) >= limit)
+					return 0;
+
+				radix_heap_min(s);
+				if (s->min >= limit)
+					return 0;
+
+				//! the new floor lies in bucket i, so its elements all land in lower buckets
+				uint64_t last = s->last;
+				s->last = s->min;
+				if (radix_heap_spread_(s, s->b[i].p, s->b[i].n))
+				{
+					s->last = last;
+					return 0;
+				}
+				s->b[i].n = 0;
+				s->mask &= ~bit;
+			}
+			return s->last < limit ? s->b[0].p[s->b[0].n - 1].e : 0;
+		}
+
+		template <typename T>
+		T* radix_heap_pop(radix_heap<T>* s)
+		{
+			if (s->b[0].n)
+			{
+				T* e = s->b[0].p[--s->b[0].n].e;
+				e->list_slot = -1;
+				e->min_heap_idx = -1;
+				--s->n;
+				if (s->min_valid && s->min == s->last)
+					s->min_valid = s->b[0].n != 0;
+				return e;
+			}
+			return 0;
+		}
+
+		template <typename T>
+		int radix_heap_erase(radix_heap<T>* s, T* e)
+		{
+			if (-1 != e->list_slot)
+			{
+				uint64_t key = s->b[e->list_slot].p[e->min_heap_idx].key;
+				radix_heap_unlink_(s, e);
+				--s->n;
+				if (s->min_valid && s->min == key)
+					s->min_valid = 0;
+				return 0;
+			}
+			return -1;
+		}
+
+		template <typename T>
+		int radix_heap_adjust(radix_heap<T>* s, T* e)
+		{
+			if (-1 != e->list_slot)
+			{
+				//! the old key may have been the cached minimum
+				radix_heap_unlink_(s, e);
+				--s->n;
+				s->min_valid = 0;
+				return radix_heap_push(s, e);
+			}
+			return -1;
+		}
+
+		template <typename T>
+		int64_t radix_heap_min(radix_heap<T>* s)
+		{
+			if (s->b[0].n)
+				return static_cast<int64_t>(s->last ^ (uint64_t(1) << 63));
+			if (!s->mask)
+				return INT64_MAX;
+
+			if (!s->min_valid)
+			{
+				//! buckets cover ascending key ranges, the lowest occupied one holds the minimum
+				const radix_heap_bucket<T>& b = s->b[radix_heap_bits_(s->mask & (~s->mask + 1))];
+				uint64_t min = b.p[0].key;
+				for (unsigned i = 1; i < b.n; ++i)
+					min = b.p[i].key < min ? b.p[i].key : min;
+				s->min = min;
+				s->min_valid = 1;
+			}
+			return static_cast<int64_t>(s->min ^ (uint64_t(1) << 63));
+		}
+
+		//! room to append until n elements are queued
+		template <typename T>
+		int radix_heap_reserve(radix_heap<T>* s, unsigned n)
+		{
+			radix_heap_bucket<T>& stage = s->b[RADIX_HEAP_STAGE];
+			return n > s->n ? radix_heap_grow_(&stage, stage.n + (n - s->n)) : 0;
+		}
+
+		//! park e unplaced (room must be reserved), radix_heap_heapify places the batch
+		template <typename T>
+		void radix_heap_append(radix_heap<T>* s, T* e)
+		{
+			radix_heap_entry<T> x = { radix_heap_elem_key(e), e };
+			radix_heap_link_(s, RADIX_HEAP_STAGE, x);
+			++s->n;
+		}
+
+		//! place the appended elements, the floor is lowered once if the batch reaches below it.
+		//! out of memory leaves them parked, radix_heap_top retries
+		template <typename T>
+		void radix_heap_heapify(radix_heap<T>* s, unsigned)
+		{
+			radix_heap_bucket<T>& stage = s->b[RADIX_HEAP_STAGE];
+			if (!stage.n)
+				return;
+
+			uint64_t min = stage.p[0].key;
+			for (unsigned i = 1; i < stage.n; ++i)
+				min = stage.p[i].key < min ? stage.p[i].key : min;
+
+			s->min_valid = 0;
+			if (min < s->last)
+			{
+				radix_heap_rewind_(s, min);
+				return;
+			}
+			if (0 == radix_heap_spread_(s, stage.p, stage.n))
+				stage.n = 0;
+		}
+
+		//! drop every element fn returns nonzero for (fn may dispose of it), returns the number dropped
+		template <typename T, typename F>
+		unsigned radix_heap_sweep(radix_heap<T>* s, F fn)
+		{
+			unsigned dropped = 0;
+			for (int i = 0; i < RADIX_HEAP_SLOTS; ++i)
+			{
+				radix_heap_bucket<T>& b = s->b[i];
+				unsigned n = 0;
+				for (unsigned k = 0; k < b.n; ++k)
+				{
+					radix_heap_entry<T> x = b.p[k];
+					x.e->list_slot = -1;
+					x.e->min_heap_idx = -1;
+					if (fn(x.e))
+						continue;
+					x.e->list_slot = i;
+					x.e->min_heap_idx = static_cast<int32_t>(n);
+					b.p[n++] = x;
+				}
+				dropped += b.n - n;
+				b.n = n;
+				if (!n && i > 0 && i < RADIX_HEAP_BUCKETS)
+					s->mask &= ~(uint64_t(1) << (i - 1));
+			}
+			s->n -= dropped;
+			s->min_valid = 0;
+			return dropped;
+		}
+
+		//! sum of fn over the elements keyed below key, buckets are visited in key order
+		//! and the walk stops at the first one starting at or above key
+		template <typename T, typename F>
+		unsigned radix_heap_count_below(radix_heap<T>* s, int64_t key, F fn)
+		{
+			uint64_t limit = static_cast<uint64_t>(key) ^ (uint64_t(1) << 63);
+			unsigned n = 0;
+			auto walk = [&n, &fn, limit](const radix_heap_bucket<T>& b)
+			{
+				for (unsigned i = 0; i < b.n; ++i)
+				{
+					if (b.p[i].key < limit)
+						n += fn(b.p[i].e);
+				}
+			};
+
+			walk(s->b[RADIX_HEAP_STAGE]);
+			walk(s->b[0]);
+			for (int i = 1; i < RADIX_HEAP_BUCKETS; ++i)
+			{
+				uint64_t bit = uint64_t(1) << (i - 1);
+				if (((s->last | bit) & ~(bit - 1)) >= limit)
+					break;
+				walk(s->b[i]);
+			}
+			return n;
+		}
+
+		template <typename T>
+		int radix_heap_grow_(radix_heap_bucket<T>* b, unsigned n)
+		{
+			if (b->a < n)
+			{
+				unsigned a = b->a ? b->a * 2 : 8;
+				if (a < n)
+					a = n;
+				radix_heap_entry<T>* p = (radix_heap_entry<T>*)realloc(b->p, a * sizeof *p);
+				if (!p)
+					return -1;
+				b->p = p;
+				b->a = a;
+			}
+			return 0;
+		}
+
+		//! room must be there
+		template <typename T>
+		void radix_heap_link_(radix_heap<T>* s, int slot, radix_heap_entry<T> x)
+		{
+			radix_heap_bucket<T>& b = s->b[slot];
+			x.e->list_slot = slot;
+			x.e->min_heap_idx = static_cast<int32_t>(b.n);
+			b.p[b.n++] = x;
+			if (slot > 0 && slot < RADIX_HEAP_BUCKETS)
+				s->mask |= uint64_t(1) << (slot - 1);
+		}
+
+		template <typename T>
+		void radix_heap_unlink_(radix_heap<T>* s, T* e)
+		{
+			radix_heap_bucket<T>& b = s->b[e->list_slot];
+			unsigned idx = static_cast<unsigned>(e->min_heap_idx);
+			if (idx != --b.n)
+				(b.p[idx] = b.p[b.n]).e->min_heap_idx = static_cast<int32_t>(idx);
+			if (!b.n && e->list_slot > 0 && e->list_slot < RADIX_HEAP_BUCKETS)
+				s->mask &= ~(uint64_t(1) << (e->list_slot - 1));
+			e->list_slot = -1;
+			e->min_heap_idx = -1;
+		}
+
+		//! place n entries (none of them stored in a bucket they can land in) against the
+		//! current floor. room is made for all of them first, on failure nothing moved
+		template <typename T>
+		int radix_heap_spread_(radix_heap<T>* s, const radix_heap_entry<T>* p, unsigned n)
+		{
+			unsigned count[RADIX_HEAP_BUCKETS] = { 0 };
+			for (unsigned i = 0; i < n; ++i)
+				++count[radix_heap_bits_(p[i].key ^ s->last)];
+
+			for (int i = 0; i < RADIX_HEAP_BUCKETS; ++i)
+			{
+				if (count[i] && radix_heap_grow_(&s->b[i], s->b[i].n + count[i]))
+					return -1;
+			}
+
+			for (unsigned i = 0; i < n; ++i)
+				radix_heap_link_(s, radix_heap_bits_(p[i].key ^ s->last), p[i]);
+			return 0;
+		}
+
+		//! lower the floor to key, every element is parked and placed again, O(n)
+		template <typename T>
+		int radix_heap_rewind_(radix_heap<T>* s, uint64_t key)
+		{
+			radix_heap_bucket<T>& stage = s->b[RADIX_HEAP_STAGE];
+			if (radix_heap_grow_(&stage, s->n))
+				return -1;
+
+			for (int i = 0; i < RADIX_HEAP_BUCKETS; ++i)
+			{
+				for (unsigned k = 0; k < s->b[i].n; ++k)
+					radix_heap_link_(s, RADIX_HEAP_STAGE, s->b[i].p[k]);
+				s->b[i].n = 0;
+			}
+
+			s->mask = 0;
+			s->last = key;
+			s->min_valid = 0;
+			if (0 == radix_heap_spread_(s, stage.p, stage.n))
+				stage.n = 0;
+			return 0;
+		}
+
+		//! number of significant bits, 0 for 0
+		int radix_heap_bits_(uint64_t x)
+		{
+#if defined(__GNUC__)
+			return x ? 64 - __builtin_clzll(x) : 0;
+#else
+			int n = 0;
+			while (x)
+			{
+				++n;
+				x >>= 1;
+			}
+			return n;
+#endif
+		}
+	}
+}
+
+#endif
@@ -1,11 +1,14 @@
 #include <stdio.h>
 #include "timer.h"
+#include "timer_fd.h"
 
 #include <iostream>
 #include <random>
 
 #if defined(WIN32)
 #include <windows.h>
+#elif defined(__linux__)
+#include <sys/epoll.h>
 #else
 #include <unistd.h>
 #endif
@@ -26,17 +29,15 @@ public:
 	RecommendTest()
 	{
 		using namespace gsf::utils;
-		timer_event_ptr_ = Timer::instance().add_timer(delay_milliseconds(3000)
+		timer_id_ = Timer::instance().add_timer(delay_milliseconds(3000)
 			, makeTimerHandler(&RecommendTest::pt, this, std::string("hello!")));
 	}
 
 	~RecommendTest()
 	{
-		if (timer_event_ptr_){
-			if (gsf::utils::Timer::instance().rmv_timer(timer_event_ptr_) == 0){ //! succ
-				delete timer_event_ptr_;
-				timer_event_ptr_ = nullptr;
-			}
+		if (timer_id_){
+			gsf::utils::Timer::instance().rmv_timer(timer_id_); //! a stale id is rejected, no need to track firing
+			timer_id_ = 0;
 		}
 	}
 
@@ -44,12 +45,11 @@ public:
 	{
 		std::cout << str.c_str() << std::endl;
 
-		delete timer_event_ptr_;
-		timer_event_ptr_ = nullptr;
+		timer_id_ = 0;
 	}
 
 private:
-	gsf::utils::TimerEvent *timer_event_ptr_;
+	gsf::utils::TimerID timer_id_;
 };
 
 void test_timer_delay_1000ms(const char *str)
@@ -70,6 +70,23 @@ int main()
 		Timer::instance().add_timer(delay_milliseconds(i * 100), makeTimerHandler(&TimerTest::pt, tt, i));
 	}
 
+#if defined(__linux__)
+	//! sleep until the next deadline instead of polling every ms
+	TimerFd timer_fd(Timer::instance());
+	int epfd = epoll_create1(EPOLL_CLOEXEC);
+	struct epoll_event ev = {};
+	ev.events = EPOLLIN;
+	epoll_ctl(epfd, EPOLL_CTL_ADD, timer_fd.fd(), &ev);
+	timer_fd.arm();
+
+	while (1)
+	{
+		struct epoll_event events[1];
+		if (epoll_wait(epfd, events, 1, -1) > 0){
+			timer_fd.on_readable();
+		}
+	}
+#else
 	while (1)
 	{
 		Timer::instance().update();
@@ -79,6 +96,7 @@ int main()
 		usleep(1000);
 #endif
 	}
+#endif
 
 	return 0;
 }
\ No newline at end of file
@@ -4,12 +4,33 @@
 #include <stdint.h>
 #include <memory>
 #include <map>
+#include <unordered_map>
+#include <atomic>
+#include <thread>
+#include <iterator>
+#include <vector>
 
 #include <chrono>
 #include <ctime>
 
-#include "min_heap.h"
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#endif
+
+//! the near buffer sits in front of the heaps, the timing wheel doesn't need it
+#if defined(GSF_TIMER_USE_NEAR_BUFFER) && !defined(GSF_TIMER_USE_TIMING_WHEEL)
+#define GSF_TIMER_NEAR_BUFFER 1
+#endif
+
+#include "timer_queue.h"
+#include "near_buffer.h"
+#include "event_pool.h"
+#include "timer_clock.h"
+#include "timer_calendar.h"
+#include "timer_metrics.h"
 #include "timer_handler.h"
+#include "timer_pool.h"
+#include "timer_snapshot.h"
 
 namespace gsf
 {
@@ -41,7 +62,11 @@ namespace gsf
 		};
 
 		/**!
-			fixed
+			fixed time of day, week or month in the Timer's zone (the system's local
+			time unless use_zone says otherwise). calendar timers re-arm themselves
+			after every firing until rmv_timer, the next firing is computed from a
+			schedule compiled once and shared by every timer using it. the schedule is
+			registered when the delay is built, keep it around when arming many timers.
 		*/
 		struct delay_day_tag {};
 		struct delay_day
@@ -51,17 +76,25 @@ namespace gsf
 			delay_day(uint32_t hour, uint32_t minute)
 				: hour_(hour)
 				, minute_(minute)
+				, schedule_(calendar_daily(hour, minute))
+				, id_(calendar_intern(schedule_))
 			{}
 
 			uint32_t Hour() const { return hour_; }
 			uint32_t Minute() const { return minute_; }
 
+			const calendar_schedule & schedule() const { return schedule_; }
+			uint32_t id() const { return id_; }
+
 		private:
 			uint32_t hour_;
 			uint32_t minute_;
+			calendar_schedule schedule_;
+			uint32_t id_;
 		};
 
 
+		//! day 0..7, sunday is 0 or 7
 		struct delay_week_tag {};
 		struct delay_week
 		{
@@ -70,17 +103,25 @@ namespace gsf
 			delay_week(uint32_t day, uint32_t hour)
 				: day_(day)
 				, hour_(hour)
+				, schedule_(calendar_weekly(day, hour, 0))
+				, id_(calendar_intern(schedule_))
 			{}
 
 			uint32_t Day() const { return day_; }
 			uint32_t Hour() const { return hour_; }
 
+			const calendar_schedule & schedule() const { return schedule_; }
+			uint32_t id() const { return id_; }
+
 		private:
 			uint32_t day_;
 			uint32_t hour_;
+			calendar_schedule schedule_;
+			uint32_t id_;
 		};
 
 
+		//! day 1..31, months without that day are skipped
 		struct delay_month_tag {};
 		struct delay_month
 		{
@@ -89,161 +130,1838 @@ namespace gsf
 			delay_month(uint32_t day, uint32_t hour)
 				: day_(day)
 				, hour_(hour)
+				, schedule_(calendar_monthly(day, hour, 0))
+				, id_(calendar_intern(schedule_))
 			{}
 
 			uint32_t Day() const { return day_; }
 			uint32_t Hour() const { return hour_; }
 
+			const calendar_schedule & schedule() const { return schedule_; }
+			uint32_t id() const { return id_; }
+
 		private:
 			uint32_t day_;
 			uint32_t hour_;
+			calendar_schedule schedule_;
+			uint32_t id_;
+		};
+
+		/**!
+			any calendar schedule, e.g. a cron expression "30 4 * * mon-fri".
+			the expression is parsed and registered once here, keep the delay_calendar
+			around when arming many timers with it. add_timer returns 0 for a malformed
+			expression.
+		*/
+		struct delay_calendar_tag {};
+		struct delay_calendar
+		{
+			typedef delay_calendar_tag type;
+
+			delay_calendar(const char *expr)
+			{
+				//! a malformed expression isn't registered, id 0 makes add_timer refuse it
+				id_ = calendar_parse(&schedule_, expr) ? 0 : calendar_intern(schedule_);
+			}
+
+			delay_calendar(const calendar_schedule &schedule)
+				: schedule_(schedule)
+				, id_(calendar_intern(schedule))
+			{}
+
+			const calendar_schedule & schedule() const { return schedule_; }
+			uint32_t id() const { return id_; }
+
+		private:
+			calendar_schedule schedule_;
+			uint32_t id_;
 		};
 
-		typedef std::shared_ptr<TimerHandler> TimerHandlerPtr;
+		/**!
+			periodic, fires after first (one period by default) and then every period ms
+			until rmv_timer. the TimerEvent is reused and re-sifted in place, each deadline
+			is the previous one plus period so it doesn't drift. periods missed by a late
+			update() are skipped, the phase is kept.
+		*/
+		struct delay_repeat_tag {};
+		struct delay_repeat
+		{
+			typedef delay_repeat_tag type;
+
+			delay_repeat(uint32_t period)
+				: period_(period)
+				, first_(period)
+			{}
+
+			delay_repeat(uint32_t period, uint32_t first)
+				: period_(period)
+				, first_(first)
+			{}
+
+			uint32_t period() const { return period_; }
+			uint32_t first() const { return first_; }
+
+		private:
+			uint32_t period_;
+			uint32_t first_;
+		};
 
 		struct TimerEvent
 		{
-			TimerHandlerPtr timer_handler_ptr_;
-			std::chrono::system_clock::time_point tp_;
+			TimerCallback timer_callback_;
+			int64_t tp_;	//! deadline in ticks (ms) of the Timer's clock source
+			int64_t period_;	//! 0 for one-shot timers, -id of the calendar_schedule for calendar timers
+			int64_t defer_;		//! later deadline set by reschedule, applied once tp_ surfaces. INT64_MIN if none
 			int32_t min_heap_idx;
+			int32_t near_idx;	//! slot in the near buffer, -1 if not there
+
+			/**!
+				timer coalescing. a bucket is a queued event whose bucket_prev / bucket_next
+				ring (with the bucket as sentinel) holds the members sharing its deadline.
+				members point at their bucket and aren't queued themselves.
+			*/
+			TimerEvent *bucket_;
+			TimerEvent *bucket_prev;
+			TimerEvent *bucket_next;
+			uint32_t slack_;	//! coalescing granularity (power of 2 ms), 0 for exact timers
+
+			uint64_t key_;		//! ordering key on a TimerPool, 0 if the callback may run anywhere
+
+			//! intrusive links for list based queues (timing wheel)
+			TimerEvent *list_prev;
+			TimerEvent *list_next;
+			int32_t list_slot;
+
+			//! slot in the owning Timer's event pool
+			uint32_t pool_idx;
+			uint32_t generation;
+
+			//! cross thread state, generation << 32 | TIMER_SYNC_* flags
+			std::atomic<uint64_t> sync;
+			TimerEvent *inbox_next;
+		};
+
+		enum
+		{
+			TIMER_SHARD_MAX = 255,		//! shard ids 0..254, a Timer created beyond that keeps 255 and can't be routed to
+			TIMER_CALENDAR_CACHE = 8,	//! schedules whose next firing is remembered during one update()
+			TIMER_NEAR_HORIZON = 8,		//! ms, timers due sooner are staged in the near buffer
+			TIMER_NEAR_CAPACITY = 1024,	//! near buffer slots, timers beyond that go to the heap
+		};
+
+		enum
+		{
+			TIMER_SYNC_QUEUED = 1,		//! linked in the inbox
+			TIMER_SYNC_PENDING = 2,		//! added from another thread, tp_ still holds the delay
+			TIMER_SYNC_CANCEL = 4,		//! removed, the slot is released once it leaves the inbox
+			TIMER_SYNC_FIRED = 8,		//! claimed by update() for firing, held until a pooled callback returns
+			TIMER_SYNC_REPEAT = 16,		//! periodic, can still be removed while FIRED
 		};
 
+#if defined(__cpp_impl_coroutine)
+		class TimerSleep;
+#endif
+
 		class Timer
 		{
 		public:
 
+			/**!
+				independent timers, e.g. one per worker thread. each live Timer takes
+				one of TIMER_SHARD_MAX shard ids, which is stamped into its TimerIDs.
+				a Timer must outlive every rmv_timer that may be routed to it.
+			*/
+			Timer();
 			~Timer();
+
+			//! process wide instance, owned by the thread that first asks for it
 			static Timer& instance();
 
+			//! the calling thread's own Timer, created on first use
+			static Timer& local();
+
+			//! the live Timer registered under shard, nullptr if none
+			static Timer* shard(uint32_t shard);
+
+			/**!
+				returns the id of the armed timer, 0 if the delay type isn't supported or
+				timer_callback is empty. the id goes stale once the timer fired or was removed.
+				may be called from any thread. calls from a thread other than the owner
+				take a pre-allocated slot and go through a lock-free inbox that the next
+				update() drains; they return 0 when that reserve is exhausted.
+
+				slack (ms) lets a one-shot timer fire up to that much late. its deadline is
+				rounded up to a multiple of the largest power of 2 <= slack, and timers that
+				land on the same tick share one queue entry and fire in one pass.
+				periodic timers ignore it.
+			*/
+			template <typename T>
+			TimerID add_timer(T delay, TimerCallback timer_callback, uint32_t slack = 0);
+
+			/**!
+				arm a batch at once, e.g. at start up or on zone load. [first, last) holds
+				(delay, callback) pairs (std::pair or anything with first / second), the
+				callbacks are moved out. the queue reserves once, then is rebuilt bottom-up
+				in O(n) when the batch outweighs the pending timers, or the batch is merged
+				by sifting up. writes one id per element to ids in input order (0 where
+				add_timer would return 0) and returns the advanced output iterator.
+			*/
+			template <typename ForwardIt, typename OutputIt>
+			OutputIt add_timers(ForwardIt first, ForwardIt last, OutputIt ids);
+
+			/**!
+				move a pending timer to now() + delay without re-allocating it, e.g. an idle
+				timeout pushed back on every packet. an earlier deadline is sifted in place,
+				a later one is only recorded (O(1)) and applied when the old deadline comes up.
+				periodic timers keep their period, called from their callback it sets the
+				next firing. 0 succ, -1 if the id is stale. owner thread only.
+			*/
 			template <typename T>
-			TimerEvent * add_timer(T delay, TimerHandlerPtr timer_handler_ptr);
+			int reschedule(TimerID id, T delay);
 
-			int rmv_timer(TimerEvent *e);
+			/**!
+				0 succ, -1 if the id is stale (already fired, removed or never valid).
+				may be called from any thread and on any Timer: ids owned by another
+				shard are routed to it through its inbox without locking. a 0 from
+				another thread guarantees the timer won't fire.
+			*/
+			int rmv_timer(TimerID id);
 
+			//! reads the clock source once and fires everything due
 			void update();
 
+			/**!
+				fire everything due at now, a tick of the same clock source.
+				lets a game loop read the clock once per frame and share it.
+			*/
+			void update(int64_t now);
+
+			/**!
+				update(now) on a budget, for loops that must not stall on an expiry storm
+				(a long pause, a daily reset). stops after max_events callbacks or once
+				max_duration passed (checked after every callback), 0 means no limit.
+				the rest stays queued and fires first, in deadline order, next call.
+				returns the number of due timers left, 0 once caught up.
+			*/
+			unsigned update(int64_t now, uint32_t max_events, std::chrono::microseconds max_duration);
+
+			//! reads the clock source once, then as above
+			unsigned update(uint32_t max_events, std::chrono::microseconds max_duration);
+
+			/**!
+				lazy cancellation for the heap backends. with ratio > 0 rmv_timer only marks
+				the event dead in O(1) (its callback is destroyed right away), update() drops
+				dead events as they reach the top and sweeps the queue in O(n) once more than
+				ratio of it is dead. 0 (the default) erases at once. the timing wheel already
+				erases in O(1) and ignores it. next_deadline() may report a dead event.
+			*/
+			void set_lazy_cancel(double ratio);
+
+			/**!
+				run the callbacks on pool's workers instead of in update(), nullptr runs
+				them inline again. update() hands every due callback over in deadline
+				order, callbacks with the same order key (set_order_key) run one at a
+				time in that order on one worker, the others go to whichever worker is
+				free. with wait update() returns once the batch is done (helping with
+				it meanwhile), without it a callback may still run after update()
+				returned and its periodic timer is re-armed by a later update().
+				a timer stays FIRED while its callback is in flight, add_timer and
+				rmv_timer from the callbacks take the cross thread path.
+				the pool must outlive the Timer, call it before arming timers.
+			*/
+			void use_pool(TimerPool *pool, bool wait = true);
+
+			/**!
+				callbacks of timers sharing a nonzero key never overlap and run in
+				deadline order, e.g. the entity id. 0 succ, -1 if the id is stale.
+				owner thread only.
+			*/
+			int set_order_key(TimerID id, uint64_t key);
+
+			/**!
+				write every pending timer whose callback is a TimerRecord to path
+				(mapped, written, synced, then renamed over path), e.g. on shutdown.
+				other timers, timers whose callback is running and callbacks in flight
+				on a TimerPool are left out. returns the number written, -1 if the
+				file couldn't be written. owner thread only.
+			*/
+			int64_t snapshot(const char *path);
+
+			/**!
+				arm the timers of a snapshot again, in one pass with a single reserve
+				and an O(n) heapify. deadlines keep their wall clock time, those that
+				passed while the process was down fire on the next update(),
+				periodic ones skip the missed periods. the timers get new ids, passed
+				to on_timer(TimerID, const TimerRecord &) if given so they can be
+				indexed again (it runs mid restore and must not call into the Timer).
+				returns the number armed, -1 if the file is missing or malformed.
+				owner thread only.
+			*/
+			int64_t restore(const char *path);
+
+			template <typename F>
+			int64_t restore(const char *path, F on_timer);
+
+			/**!
+				tick of the earliest armed deadline, INT64_MAX if nothing is armed.
+				update(now) fires it once now > next_deadline(). a timer pushed back by
+				reschedule() still reports its old deadline, the timing wheel reports the
+				tick of a pending cascade, both just cost an early wakeup. owner thread only.
+			*/
+			int64_t next_deadline();
+
+			/**!
+				ms until update() has work to do, for epoll_wait / poll timeouts.
+				0 if something is due or waiting in the inbox, -1 if nothing is armed.
+			*/
+			int next_timeout();
+
+			/**!
+				select the clock source (steady_clock_source by default,
+				coarse_clock_source, system_clock_source or any type with a static
+				int64_t now() in ms). call it before arming timers.
+			*/
+			template <typename Clock>
+			void use_clock();
+
+			/**!
+				zone of the calendar timers (delay_day / delay_week / delay_month /
+				delay_calendar), the system's local time by default, nullptr restores
+				it. the zone must outlive the Timer, call it before arming timers.
+				wall times are read from the system clock whatever the clock source.
+			*/
+			void use_zone(const calendar_zone *zone);
+
+#if defined(GSF_TIMER_METRICS)
+			/**!
+				copy the counters and histograms (fire lateness, callbacks per update,
+				callback time) into out, e.g. once per scrape interval. recording costs
+				two clock reads per callback, without GSF_TIMER_METRICS nothing is
+				recorded at all. owner thread only.
+			*/
+			void metrics(timer_metrics &out);
+
+			void reset_metrics();
+#endif
+
+#if defined(__cpp_impl_coroutine)
+			/**!
+				co_await timer.sleep_for(100ms) suspends the coroutine until update()
+				fires the timer and resumes it right there (on the pool worker with
+				use_pool). the callback only holds the awaiter's address, so a wait
+				takes a slot of the event pool and nothing else. destroying the
+				suspended coroutine removes the timer. a wait that can't be armed
+				(another thread, remote reserve exhausted) doesn't suspend.
+			*/
+			template <typename Rep, typename Period>
+			TimerSleep sleep_for(std::chrono::duration<Rep, Period> duration);
+
+			//! until tick, a tick of the clock source, e.g. now() + 100
+			TimerSleep sleep_until(int64_t tick);
+#endif
+
+			/**!
+				the time of the last update(), deadlines of new timers are
+				relative to it rather than to a fresh clock read.
+			*/
+			int64_t now() const { return now_; }
+
+			/**!
+				make the calling thread the owner, the one thread that calls update().
+				defaults to the thread that constructed the Timer. may run while other
+				threads submit, each call takes the route of the owner it sees.
+			*/
+			void bind_thread();
+
+			/**!
+				number of slots kept ready for add_timer calls from other threads,
+				refilled by every update(). call it before other threads submit.
+			*/
+			void set_remote_reserve(uint32_t n);
+
 		private:
-			Timer();
-			static Timer* instance_;
+			static std::atomic<Timer*> * shards();
+
+			TimerID make_id(const TimerEvent *e) const;
+
+			//! ms from now until the delay is due, -1 if the delay type isn't supported
+			static int64_t delay_offset(delay_milliseconds delay, delay_milliseconds_tag);
+			int64_t delay_offset(const delay_day &delay, delay_day_tag) const;
+			int64_t delay_offset(const delay_week &delay, delay_week_tag) const;
+			int64_t delay_offset(const delay_month &delay, delay_month_tag) const;
+			int64_t delay_offset(const delay_calendar &delay, delay_calendar_tag) const;
+			static int64_t delay_offset(delay_repeat delay, delay_repeat_tag);
+
+			//! ms between two firings, 0 for one-shot delays, -id of the schedule for calendar delays
+			template <typename T>
+			static int64_t delay_period(const T &) { return 0; }
+			static int64_t delay_period(const delay_repeat &delay) { return delay.period(); }
+			static int64_t delay_period(const delay_day &delay) { return -int64_t(delay.id()); }
+			static int64_t delay_period(const delay_week &delay) { return -int64_t(delay.id()); }
+			static int64_t delay_period(const delay_month &delay) { return -int64_t(delay.id()); }
+			static int64_t delay_period(const delay_calendar &delay) { return -int64_t(delay.id()); }
+
+			const calendar_zone * zone() const;
+			//! ms from now until the schedule next fires by the wall clock, -1 if it never does
+			int64_t calendar_offset(const calendar_schedule &schedule) const;
+			//! next deadline of a calendar timer fired in this update(), INT64_MAX if none is left
+			int64_t calendar_deadline(uint32_t id);
 
-			TimerEvent * update_delay(delay_milliseconds delay, TimerHandlerPtr handler, delay_milliseconds_tag);
-			TimerEvent * update_delay(delay_day delay, TimerHandlerPtr handler, delay_day_tag);
-			TimerEvent * update_delay(delay_week delay, TimerHandlerPtr handler, delay_week_tag);
-			TimerEvent * update_delay(delay_month delay, TimerHandlerPtr handler, delay_month_tag);
+			bool is_owner() const;
+			TimerID post_timer(int64_t offset, int64_t period, uint32_t slack, TimerCallback &handler);
+			int post_rmv_timer(TimerID id);
+			void inbox_push(TimerEvent *e);
+			void drain_inbox();
+			void refill_reserve();
+			bool claim_event(TimerEvent *e);
+			bool rearm_periodic(TimerEvent *e);
+
+			int push_event(TimerEvent *e);
+			int reserve_events(unsigned n, unsigned &from);
+			void append_event(TimerEvent *e);
+			void heapify_events(unsigned from);
+			unsigned queued_events();
+			void bury_event(TimerEvent *e);
+			void sweep_events();
+			int erase_event(TimerEvent *e);
+			void enqueue_event(TimerEvent *e);
+			void unqueue_event(TimerEvent *e);
+			void fire_bucket(TimerEvent *bucket);
+			void forget_bucket(TimerEvent *bucket);
+			void spend_budget();
+			//! fn(e) for every queued event, buckets included, members not
+			template <typename F>
+			void visit_events(F fn);
+			//! due events still queued, a bucket counts its members
+			unsigned due_events();
+			void rearm_event(TimerEvent *e);
+			//! next due event, periodic ones stay queued on the heaps so they can be re-sifted in place
+			TimerEvent * pop_expired(int64_t now);
+
+			TimerEvent * alloc_event(int64_t period = 0);
+			void release_event(TimerEvent *e);
+
+			//! hand e's callback to pool_, finish_event runs once it returned
+			void dispatch_event(TimerEvent *e);
+			static void run_task(void *ctx, void *arg);
+			void drain_done();
+			void finish_event(TimerEvent *e);
+			void wait_pool();
+
+			//! metrics hooks, empty without GSF_TIMER_METRICS
+			void metrics_add(uint64_t n);
+			void metrics_cancel();
+			int64_t metrics_fire_begin(const TimerEvent *e);
+			void metrics_fire_end(int64_t begin);
+			void metrics_dispatch(const TimerEvent *e);
+			void metrics_update();
 
 		private:
 
-			min_heap<TimerEvent> min_heap_;
+			uint32_t shard_;
+
+			int64_t(*clock_)();
+			int64_t now_;
+
+			double lazy_ratio_;
+			unsigned dead_;		//! tombstones still queued
+
+			//! callbacks the running update() may still run, and when its time is up
+			uint64_t budget_;
+			std::chrono::steady_clock::time_point budget_end_;
+
+			//! pooled callbacks, events come back through done_ (linked by inbox_next)
+			TimerPool *pool_;
+			bool pool_wait_;
+			std::atomic<TimerEvent*> done_;
+			std::atomic<uint32_t> in_flight_;
+
+			//! calendar timers
+			const calendar_zone *zone_;
+			int64_t wall_update_;	//! now_ of the update() wall_now_ was read in
+			int64_t wall_now_;		//! system clock
+			int64_t wall_tick_;		//! clock source read along with it
+			struct calendar_slot
+			{
+				uint32_t id;
+				int64_t next;
+			};
+			calendar_slot calendar_cache_[TIMER_CALENDAR_CACHE];
+
+#if defined(GSF_TIMER_METRICS)
+			timer_metrics metrics_;
+			uint64_t update_fired_;
+#endif
+
+			std::unordered_map<int64_t, TimerEvent*> buckets_;	//! coalescing buckets by deadline
+
+			event_pool<TimerEvent> event_pool_;
+
+			//! cross thread submission
+			std::atomic<std::thread::id> owner_;	//! read by submitters to pick the inbox route
+			std::atomic<TimerEvent*> inbox_;
+			std::unique_ptr<std::atomic<uint32_t>[]> reserve_ring_;	//! spmc ring of pool slots
+			uint32_t reserve_mask_;
+			uint32_t reserve_size_;
+			std::atomic<uint64_t> reserve_head_;
+			std::atomic<uint64_t> reserve_tail_;
+
+			/**!
+				pending queue, GSF_TIMER_QUEUE (see timer_queue.h), min-heap unless one of
+				GSF_TIMER_USE_TIMING_WHEEL	hierarchical timing wheel (O(1) add_timer / rmv_timer)
+				GSF_TIMER_USE_DARY_HEAP		4-ary heap with keys cached inline (fewer cache misses per sift)
+				GSF_TIMER_USE_RADIX_HEAP	radix heap (O(1) add_timer / rmv_timer, no deadline comparisons)
+				is defined. with GSF_TIMER_USE_NEAR_BUFFER the heaps only take timers due
+				beyond TIMER_NEAR_HORIZON, the nearer ones skip the sifts and wait in
+				near_buffer_, which update() scans for expired ones in one vector pass.
+			*/
+			typedef GSF_TIMER_QUEUE<TimerEvent> queue_type;
+			queue_type queue_;
+#if defined(GSF_TIMER_NEAR_BUFFER)
+			near_buffer<TimerEvent> near_buffer_;
+#endif
+		};
+
+#if defined(__cpp_impl_coroutine)
+		class TimerSleep
+		{
+		public:
+			TimerSleep(Timer &timer, int64_t milliseconds)
+				: timer_(timer)
+				, milliseconds_(milliseconds)
+				, id_(0)
+			{}
+
+			//! the coroutine is destroyed while suspended
+			~TimerSleep()
+			{
+				if (id_){
+					timer_.rmv_timer(id_);
+				}
+			}
+
+			TimerSleep(const TimerSleep &) = delete;
+			TimerSleep & operator = (const TimerSleep &) = delete;
+
+			bool await_ready() const noexcept { return milliseconds_ < 0; }
+
+			bool await_suspend(std::coroutine_handle<> handle)
+			{
+				handle_ = handle;
+				id_ = timer_.add_timer(delay_milliseconds(static_cast<uint32_t>(milliseconds_ > UINT32_MAX ? UINT32_MAX : milliseconds_)), [this]() {
+					//! the frame, this awaiter included, may be gone once resume returns
+					id_ = 0;
+					handle_.resume();
+				});
+				return id_ != 0;
+			}
+
+			void await_resume() const noexcept {}
+
+		private:
+			Timer &timer_;
+			int64_t milliseconds_;
+			TimerID id_;
+			std::coroutine_handle<> handle_;
 		};
 
+		template <typename Rep, typename Period>
+		TimerSleep Timer::sleep_for(std::chrono::duration<Rep, Period> duration)
+		{
+			//! rounded up, a wait is never shorter than asked
+			std::chrono::milliseconds _ms = std::chrono::ceil<std::chrono::milliseconds>(duration);
+			return TimerSleep(*this, _ms.count() > 0 ? _ms.count() : 0);
+		}
+
+		TimerSleep Timer::sleep_until(int64_t tick)
+		{
+			//! resumed by the first update(now) with now > tick, like next_deadline(). a tick already passed doesn't suspend
+			return TimerSleep(*this, tick >= now_ ? tick - now_ : -1);
+		}
+#endif
+
 		Timer::~Timer()
 		{
+			//! the workers still hold events of this Timer
+			if (pool_){
+				wait_pool();
+			}
+
+#if defined(GSF_TIMER_NEAR_BUFFER)
+			near_buffer_dtor(&near_buffer_);
+#endif
+			event_pool_dtor(&event_pool_);
 
+			if (shard_ < TIMER_SHARD_MAX){
+				shards()[shard_].store(nullptr, std::memory_order_release);
+			}
 		}
 
 		Timer::Timer()
+			: shard_(TIMER_SHARD_MAX)
+			, clock_(&steady_clock_source::now)
+			, now_(steady_clock_source::now())
+			, lazy_ratio_(0)
+			, dead_(0)
+			, budget_(0)
+			, pool_(nullptr)
+			, pool_wait_(true)
+			, done_(nullptr)
+			, in_flight_(0)
+			, zone_(nullptr)
+			, wall_update_(INT64_MIN)
+			, wall_now_(0)
+			, wall_tick_(0)
+			, owner_(std::this_thread::get_id())
+			, inbox_(nullptr)
+			, reserve_mask_(0)
+			, reserve_size_(0)
+			, reserve_head_(0)
+			, reserve_tail_(0)
 		{
-			min_heap_ctor(&min_heap_);
+			event_pool_ctor(&event_pool_);
+			memset(calendar_cache_, 0, sizeof(calendar_cache_));
+#if defined(GSF_TIMER_METRICS)
+			reset_metrics();
+#endif
+
+			queue_.rebase(now_);
+#if defined(GSF_TIMER_NEAR_BUFFER)
+			//! out of memory leaves it with no room, everything goes to the heap
+			near_buffer_ctor(&near_buffer_, TIMER_NEAR_CAPACITY);
+#endif
+
+			set_remote_reserve(256);
+
+			for (uint32_t i = 0; i < TIMER_SHARD_MAX; ++i)
+			{
+				Timer *_expected = nullptr;
+				if (shards()[i].compare_exchange_strong(_expected, this, std::memory_order_acq_rel)){
+					shard_ = i;
+					break;
+				}
+			}
 		}
 
 		Timer& Timer::instance()
 		{
-			if (instance_ == NULL)
-			{
-				instance_ = new gsf::utils::Timer();
-			}
-			return *instance_;
+			static Timer *_instance = new gsf::utils::Timer();
+			return *_instance;
 		}
 
-		TimerEvent * Timer::update_delay(delay_milliseconds delay, TimerHandlerPtr handler, delay_milliseconds_tag)
+		Timer& Timer::local()
 		{
-			auto _tp = std::chrono::system_clock::now() + std::chrono::milliseconds(delay.milliseconds());
+			static thread_local Timer _local;
+			return _local;
+		}
 
-			TimerEvent *_event = new TimerEvent();
-			_event->timer_handler_ptr_ = handler;
-			_event->tp_ = _tp;
+		std::atomic<Timer*> * Timer::shards()
+		{
+			static std::atomic<Timer*> _shards[TIMER_SHARD_MAX] = {};
+			return _shards;
+		}
 
-			min_heap_push(&min_heap_, _event);
+		Timer* Timer::shard(uint32_t shard)
+		{
+			return shard < TIMER_SHARD_MAX ? shards()[shard].load(std::memory_order_acquire) : nullptr;
+		}
 
-			return _event;
+		TimerID Timer::make_id(const TimerEvent *e) const
+		{
+			return event_pool_id(e, shard_);
+		}
+
+		template <typename Clock>
+		void Timer::use_clock()
+		{
+			clock_ = &Clock::now;
+			now_ = clock_();
+			queue_.rebase(now_);
+		}
+
+		int64_t Timer::delay_offset(delay_milliseconds delay, delay_milliseconds_tag)
+		{
+			return delay.milliseconds();
+		}
+
+		int64_t Timer::delay_offset(const delay_day &delay, delay_day_tag) const
+		{
+			return delay.id() ? calendar_offset(delay.schedule()) : -1;
+		}
+
+		int64_t Timer::delay_offset(const delay_week &delay, delay_week_tag) const
+		{
+			return delay.id() ? calendar_offset(delay.schedule()) : -1;
+		}
+
+		int64_t Timer::delay_offset(const delay_month &delay, delay_month_tag) const
+		{
+			return delay.id() ? calendar_offset(delay.schedule()) : -1;
+		}
+
+		int64_t Timer::delay_offset(const delay_calendar &delay, delay_calendar_tag) const
+		{
+			return delay.id() ? calendar_offset(delay.schedule()) : -1;
+		}
+
+		int64_t Timer::delay_offset(delay_repeat delay, delay_repeat_tag)
+		{
+			return delay.period() ? delay.first() : -1;
 		}
 
-		TimerEvent * Timer::update_delay(delay_day delay, TimerHandlerPtr handler, delay_day_tag)
+		void Timer::use_zone(const calendar_zone *zone)
 		{
-			using namespace std::chrono;
-			//! 
+			zone_ = zone;
+			wall_update_ = INT64_MIN;
+		}
+
+		const calendar_zone * Timer::zone() const
+		{
+			return zone_ ? zone_ : calendar_zone_local();
+		}
 
-			typedef duration<int, std::ratio<60 * 60 * 24>> dur_day;
-			time_point<system_clock, dur_day> _today = time_point_cast<dur_day>(system_clock::now());
+		int64_t Timer::calendar_offset(const calendar_schedule &schedule) const
+		{
+			//! the time of day comes from the wall clock, the deadline itself is a tick of the clock source
+			int64_t _wall = system_clock_source::now();
+			int64_t _next = calendar_next(&schedule, zone(), _wall);
+			if (_next == INT64_MAX){
+				return -1;
+			}
 
-			time_point<system_clock, seconds> _second = time_point_cast<seconds>(system_clock::now());
+			//! the owner counts from now_, which may be a while ago. other threads' offsets count from the drain
+			int64_t _offset = _next - _wall;
+			if (is_owner()){
+				_offset += clock_() - now_;
+			}
+			return _offset > 0 ? _offset : 0;
+		}
 
-			uint32_t _passed_second = static_cast<uint32_t>(_second.time_since_epoch().count() - _today.time_since_epoch().count() * 24 * 60 * 60);
-			uint32_t _space_second = delay.Hour() * 60 * 60 + delay.Minute() * 60;
+		int64_t Timer::calendar_deadline(uint32_t id)
+		{
+			//! timers sharing a schedule fire together (e.g. a daily reset), the next firing is computed once
+			if (wall_update_ != now_)
+			{
+				wall_now_ = system_clock_source::now();
+				wall_tick_ = clock_();
+				wall_update_ = now_;
+				memset(calendar_cache_, 0, sizeof(calendar_cache_));
+			}
 
-			TimerEvent *_event = new TimerEvent();
-			if (_space_second > _passed_second){
-				_event->tp_ = _second + seconds(_space_second - _passed_second);
+			calendar_slot &_slot = calendar_cache_[id & (TIMER_CALENDAR_CACHE - 1)];
+			if (_slot.id != id)
+			{
+				//! a wall clock slightly behind the clock source must not hit the firing just done
+				_slot.id = id;
+				_slot.next = calendar_next(calendar_at(id), zone(), wall_now_ + 1000);
 			}
-			else {
-				_event->tp_ = _second + seconds((24 * 60 * 60) - _passed_second - _space_second);
+			return _slot.next == INT64_MAX ? INT64_MAX : wall_tick_ + (_slot.next - wall_now_);
+		}
+
+		int Timer::push_event(TimerEvent *e)
+		{
+#if defined(GSF_TIMER_NEAR_BUFFER)
+			if (e->tp_ - now_ < TIMER_NEAR_HORIZON && !near_buffer_full(&near_buffer_))
+			{
+				near_buffer_push(&near_buffer_, e);
+				return 0;
 			}
+#endif
+			return queue_.push(e);
+		}
 
-			_event->timer_handler_ptr_ = handler;
+		int Timer::reserve_events(unsigned n, unsigned &from)
+		{
+			from = queue_.size();
+			return queue_.reserve(from + n);
+		}
 
-			min_heap_push(&min_heap_, _event);
+		void Timer::append_event(TimerEvent *e)
+		{
+			queue_.append(e);
+		}
 
-			return _event;
+		void Timer::heapify_events(unsigned from)
+		{
+			queue_.heapify(from);
 		}
 
-		TimerEvent * Timer::update_delay(delay_week delay, TimerHandlerPtr handler, delay_week_tag)
+		unsigned Timer::queued_events()
 		{
-			return nullptr;
+#if defined(GSF_TIMER_NEAR_BUFFER)
+			unsigned _near = near_buffer_size(&near_buffer_);
+#else
+			unsigned _near = 0;
+#endif
+			return queue_.size() + _near;
+		}
+
+		void Timer::bury_event(TimerEvent *e)
+		{
+			//! stays queued until it reaches the top or the next sweep, CANCEL keeps it from firing
+			e->timer_callback_.reset();
+			//! a pending reschedule would re-arm the tombstone instead of letting it go at its current deadline
+			e->defer_ = INT64_MIN;
+			++dead_;
+		}
+
+		void Timer::sweep_events()
+		{
+			auto _dead = [this](TimerEvent *e) -> int
+			{
+				if ((e->sync.load(std::memory_order_acquire) & (TIMER_SYNC_CANCEL | TIMER_SYNC_QUEUED)) != TIMER_SYNC_CANCEL){
+					return 0;
+				}
+				release_event(e);
+				return 1;
+			};
+
+			dead_ -= queue_.sweep(_dead);
+#if defined(GSF_TIMER_NEAR_BUFFER)
+			dead_ -= near_buffer_sweep(&near_buffer_, _dead);
+#endif
+		}
+
+		void Timer::set_lazy_cancel(double ratio)
+		{
+			lazy_ratio_ = queue_type::lazy_cancel ? ratio : 0;
+		}
+
+		int Timer::erase_event(TimerEvent *e)
+		{
+#if defined(GSF_TIMER_NEAR_BUFFER)
+			if (0 == near_buffer_erase(&near_buffer_, e)){
+				return 0;
+			}
+#endif
+			return queue_.erase(e);
 		}
 
-		TimerEvent * Timer::update_delay(delay_month delay, TimerHandlerPtr handler, delay_month_tag)
+		TimerEvent * Timer::pop_expired(int64_t now)
 		{
+#if defined(GSF_TIMER_NEAR_BUFFER)
+			//! merge the expired part of the near buffer with the heap, earliest first
+			TimerEvent *_near = near_buffer_top(&near_buffer_, now);
+#else
+			TimerEvent *_near = nullptr;
+#endif
+			//! periodic events stay queued so rearm_event can move them in place
+			TimerEvent *_event = queue_.top(now);
+			if (_event && (!_near || _event->tp_ < _near->tp_)){
+				return _event->period_ ? _event : queue_.pop();
+			}
+#if defined(GSF_TIMER_NEAR_BUFFER)
+			if (_near){
+				return near_buffer_pop(&near_buffer_);
+			}
+#endif
 			return nullptr;
 		}
 
-		int Timer::rmv_timer(TimerEvent *e)
+		void Timer::rearm_event(TimerEvent *e)
 		{
-			return min_heap_erase(&min_heap_, e);
+#if defined(GSF_TIMER_NEAR_BUFFER)
+			//! staged or already taken out by pop_expired, the new deadline picks its queue
+			if (0 == near_buffer_erase(&near_buffer_, e))
+			{
+				push_event(e);
+				return;
+			}
+#endif
+			if (queue_.adjust(e)){
+				push_event(e);
+			}
 		}
 
-		template <typename T>
-		TimerEvent * gsf::utils::Timer::add_timer(T delay, TimerHandlerPtr timer_handler_ptr)
+		int64_t Timer::next_deadline()
 		{
-			return update_delay(delay, timer_handler_ptr, typename timer_traits<T>::type());
+#if defined(GSF_TIMER_NEAR_BUFFER)
+			int64_t _near = near_buffer_min(&near_buffer_);
+#else
+			int64_t _near = INT64_MAX;
+#endif
+			int64_t _heap = queue_.next_deadline();
+			return _near < _heap ? _near : _heap;
 		}
 
-		void Timer::update()
+		int Timer::next_timeout()
+		{
+			if (inbox_.load(std::memory_order_relaxed) || done_.load(std::memory_order_relaxed)){
+				return 0;
+			}
+
+			int64_t _deadline = next_deadline();
+			if (_deadline == INT64_MAX){
+				return -1;
+			}
+
+			//! due once the clock passes the deadline tick
+			int64_t _wait = _deadline + 1 - clock_();
+			if (_wait <= 0){
+				return 0;
+			}
+			return _wait > INT32_MAX ? INT32_MAX : static_cast<int>(_wait);
+		}
+
+		TimerEvent * Timer::alloc_event(int64_t period)
+		{
+			TimerEvent *_event = event_pool_alloc(&event_pool_);
+			queue_type::elem_init(_event);
+#if defined(GSF_TIMER_NEAR_BUFFER)
+			near_buffer_elem_init(_event);
+#endif
+			_event->period_ = period;
+			_event->defer_ = INT64_MIN;
+			_event->bucket_ = _event->bucket_prev = _event->bucket_next = nullptr;
+			_event->slack_ = 0;
+			_event->key_ = 0;
+			_event->sync.store((uint64_t(_event->generation) << 32) | (period ? TIMER_SYNC_REPEAT : 0), std::memory_order_relaxed);
+			return _event;
+		}
+
+		void Timer::release_event(TimerEvent *e)
 		{
-			using namespace std::chrono;
+			e->timer_callback_.reset();
+			event_pool_free(&event_pool_, e);
+			//! every path here holds CANCEL or FIRED, so no other thread can be mid CAS
+			e->sync.store(uint64_t(e->generation) << 32, std::memory_order_release);
+		}
 
-			if (!min_heap_empty(&min_heap_))
+		int Timer::rmv_timer(TimerID id)
+		{
+			uint32_t _shard = timer_id_shard(id);
+			if (_shard != shard_)
 			{
-				TimerEvent *_event_ptr = min_heap_top(&min_heap_);
-				auto _now = time_point_cast<milliseconds>(system_clock::now());
+				Timer *_owner = shard(_shard);
+				return _owner ? _owner->rmv_timer(id) : -1;
+			}
 
-				while (_event_ptr->tp_ < _now)
-				{
-					min_heap_pop(&min_heap_);
+			if (!is_owner()){
+				return post_rmv_timer(id);
+			}
 
-					_event_ptr->timer_handler_ptr_->handleTimeout();
+			TimerEvent *_event = event_pool_get(&event_pool_, id);
+			if (!_event){
+				return -1;
+			}
 
-					if (!min_heap_empty(&min_heap_)){
-						_event_ptr = min_heap_top(&min_heap_);
-					}
-					else {
-						break;
-					}
+			uint64_t _sync = _event->sync.load(std::memory_order_acquire);
+			do
+			{
+				//! firing (or already removed from another thread), periodic timers may stop themselves
+				if ((_sync & TIMER_SYNC_CANCEL) || (_sync & (TIMER_SYNC_FIRED | TIMER_SYNC_REPEAT)) == TIMER_SYNC_FIRED){
+					return -1;
 				}
+			} while (!_event->sync.compare_exchange_weak(_sync, _sync | TIMER_SYNC_CANCEL, std::memory_order_acq_rel, std::memory_order_acquire));
+
+			metrics_cancel();
+
+			//! still waiting in the inbox, drain_inbox releases it. mid callback, update() does
+			if (_sync & (TIMER_SYNC_QUEUED | TIMER_SYNC_FIRED)){
+				return 0;
 			}
+
+			//! bucket members unlink in O(1), no tombstone needed
+			if (lazy_ratio_ > 0 && !_event->bucket_){
+				bury_event(_event);
+				return 0;
+			}
+
+			unqueue_event(_event);
+			release_event(_event);
+			return 0;
 		}
 
+		template <typename T>
+		TimerID gsf::utils::Timer::add_timer(T delay, TimerCallback timer_callback, uint32_t slack)
+		{
+			int64_t _offset = delay_offset(delay, typename timer_traits<T>::type());
+			if (_offset < 0 || !timer_callback){
+				return 0;
+			}
+
+			int64_t _period = delay_period(delay);
+			uint32_t _slack = 0;
+			if (slack && !_period)
+			{
+				_slack = 1;
+				while (_slack <= slack / 2 && _slack < (1u << 30)){
+					_slack <<= 1;
+				}
+			}
+
+			if (!is_owner()){
+				return post_timer(_offset, _period, _slack, timer_callback);
+			}
+
+			TimerEvent *_event = alloc_event(_period);
+			_event->timer_callback_ = std::move(timer_callback);
+			_event->tp_ = now_ + _offset;
+			_event->slack_ = _slack;
+
+			enqueue_event(_event);
+			metrics_add(1);
+
+			return make_id(_event);
+		}
+
+		template <typename T>
+		int gsf::utils::Timer::reschedule(TimerID id, T delay)
+		{
+			int64_t _offset = delay_offset(delay, typename timer_traits<T>::type());
+			if (_offset < 0 || timer_id_shard(id) != shard_ || !is_owner()){
+				return -1;
+			}
+
+			TimerEvent *_event = event_pool_get(&event_pool_, id);
+			if (!_event){
+				return -1;
+			}
+
+			uint64_t _sync = _event->sync.load(std::memory_order_acquire);
+			if ((_sync & TIMER_SYNC_CANCEL) || (_sync & (TIMER_SYNC_FIRED | TIMER_SYNC_REPEAT)) == TIMER_SYNC_FIRED){
+				return -1;
+			}
+
+			//! added from another thread and not drained yet, tp_ still holds the delay
+			if (_sync & TIMER_SYNC_PENDING)
+			{
+				_event->tp_ = _offset;
+				return 0;
+			}
+
+			int64_t _tp = now_ + _offset;
+
+			//! coalesced, moving to another bucket is O(1) anyway
+			if (_event->bucket_)
+			{
+				unqueue_event(_event);
+				_event->tp_ = _tp;
+				enqueue_event(_event);
+				return 0;
+			}
+
+			//! periodic timer in its callback, rearm_periodic picks it up
+			if (_sync & TIMER_SYNC_FIRED)
+			{
+				_event->defer_ = _tp;
+				return 0;
+			}
+
+			if (_tp > _event->tp_)
+			{
+				_event->defer_ = _tp;
+				return 0;
+			}
+
+			_event->tp_ = _tp;
+			_event->defer_ = INT64_MIN;
+			rearm_event(_event);
+			return 0;
+		}
+
+		template <typename ForwardIt, typename OutputIt>
+		OutputIt gsf::utils::Timer::add_timers(ForwardIt first, ForwardIt last, OutputIt ids)
+		{
+			if (!is_owner())
+			{
+				for (; first != last; ++first){
+					*ids++ = add_timer(first->first, std::move(first->second));
+				}
+				return ids;
+			}
+
+			//! out of memory for the batch, fall back to one push per timer
+			unsigned _from = 0;
+			uint64_t _added = 0;
+			bool _bulk = 0 == reserve_events(static_cast<unsigned>(std::distance(first, last)), _from);
+
+			for (; first != last; ++first)
+			{
+				int64_t _offset = delay_offset(first->first, typename timer_traits<typename std::decay<decltype(first->first)>::type>::type());
+				TimerCallback _callback(std::move(first->second));
+				if (_offset < 0 || !_callback)
+				{
+					*ids++ = 0;
+					continue;
+				}
+
+				TimerEvent *_event = alloc_event(delay_period(first->first));
+				_event->timer_callback_ = std::move(_callback);
+				_event->tp_ = now_ + _offset;
+
+				if (_bulk){
+					append_event(_event);
+				}
+				else {
+					push_event(_event);
+				}
+				*ids++ = make_id(_event);
+				++_added;
+			}
+
+			if (_bulk){
+				heapify_events(_from);
+			}
+			metrics_add(_added);
+			return ids;
+		}
+
+		bool Timer::is_owner() const
+		{
+			return std::this_thread::get_id() == owner_.load(std::memory_order_acquire);
+		}
+
+		void Timer::bind_thread()
+		{
+			owner_.store(std::this_thread::get_id(), std::memory_order_release);
+		}
+
+		void Timer::set_remote_reserve(uint32_t n)
+		{
+			//! hand the slots still in the ring back to the pool
+			uint64_t _head = reserve_head_.load(std::memory_order_acquire);
+			uint64_t _tail = reserve_tail_.load(std::memory_order_relaxed);
+			for (; _head != _tail; ++_head)
+			{
+				release_event(event_pool_at(&event_pool_, reserve_ring_[_head & reserve_mask_].load(std::memory_order_relaxed)));
+			}
+
+			uint32_t _cap = 1;
+			while (_cap < n){
+				_cap <<= 1;
+			}
+
+			reserve_ring_.reset(new std::atomic<uint32_t>[_cap]);
+			reserve_mask_ = _cap - 1;
+			reserve_size_ = n;
+			reserve_head_.store(0, std::memory_order_relaxed);
+			reserve_tail_.store(0, std::memory_order_release);
+
+			refill_reserve();
+		}
+
+		void Timer::refill_reserve()
+		{
+			uint64_t _tail = reserve_tail_.load(std::memory_order_relaxed);
+			uint64_t _head = reserve_head_.load(std::memory_order_acquire);
+
+			for (; _tail - _head < reserve_size_; ++_tail)
+			{
+				TimerEvent *_event = alloc_event();
+				reserve_ring_[_tail & reserve_mask_].store(_event->pool_idx, std::memory_order_relaxed);
+			}
+
+			reserve_tail_.store(_tail, std::memory_order_release);
+		}
+
+		TimerID Timer::post_timer(int64_t offset, int64_t period, uint32_t slack, TimerCallback &handler)
+		{
+			uint64_t _head = reserve_head_.load(std::memory_order_acquire);
+			for (;;)
+			{
+				if (_head == reserve_tail_.load(std::memory_order_acquire)){
+					return 0;
+				}
+
+				uint32_t _index = reserve_ring_[_head & reserve_mask_].load(std::memory_order_relaxed);
+				if (reserve_head_.compare_exchange_weak(_head, _head + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+				{
+					//! the slot is ours until it is pushed to the inbox
+					TimerEvent *_event = event_pool_slot(&event_pool_, _index);
+					_event->timer_callback_ = std::move(handler);
+					_event->tp_ = offset;
+					_event->period_ = period;
+					_event->slack_ = slack;
+
+					uint64_t _sync = _event->sync.load(std::memory_order_relaxed);
+					_event->sync.store(_sync | TIMER_SYNC_PENDING | TIMER_SYNC_QUEUED | (period ? TIMER_SYNC_REPEAT : 0), std::memory_order_relaxed);
+					inbox_push(_event);
+
+					return make_timer_id(_index, static_cast<uint32_t>(_sync >> 32), shard_);
+				}
+			}
+		}
+
+		int Timer::post_rmv_timer(TimerID id)
+		{
+			TimerEvent *_event = event_pool_slot(&event_pool_, timer_id_index(id));
+			if (!_event){
+				return -1;
+			}
+
+			uint64_t _sync = _event->sync.load(std::memory_order_acquire);
+			uint64_t _next = 0;
+			do
+			{
+				if ((_sync >> 32) != timer_id_generation(id) || (_sync & TIMER_SYNC_CANCEL) || (_sync & (TIMER_SYNC_FIRED | TIMER_SYNC_REPEAT)) == TIMER_SYNC_FIRED){
+					return -1;
+				}
+				//! a periodic timer mid callback only needs the flag, update() releases it afterwards
+				_next = (_sync & TIMER_SYNC_FIRED) ? _sync | TIMER_SYNC_CANCEL : _sync | TIMER_SYNC_CANCEL | TIMER_SYNC_QUEUED;
+			} while (!_event->sync.compare_exchange_weak(_sync, _next, std::memory_order_acq_rel, std::memory_order_acquire));
+
+			if (!(_sync & (TIMER_SYNC_QUEUED | TIMER_SYNC_FIRED))){
+				inbox_push(_event);
+			}
+			return 0;
+		}
+
+		void Timer::inbox_push(TimerEvent *e)
+		{
+			TimerEvent *_head = inbox_.load(std::memory_order_relaxed);
+			do
+			{
+				e->inbox_next = _head;
+			} while (!inbox_.compare_exchange_weak(_head, e, std::memory_order_release, std::memory_order_relaxed));
+		}
+
+		void Timer::drain_inbox()
+		{
+			TimerEvent *_list = inbox_.exchange(nullptr, std::memory_order_acquire);
+
+			//! producers push in front, restore submission order
+			TimerEvent *_fifo = nullptr;
+			while (_list)
+			{
+				TimerEvent *_next = _list->inbox_next;
+				_list->inbox_next = _fifo;
+				_fifo = _list;
+				_list = _next;
+			}
+
+			while (_fifo)
+			{
+				TimerEvent *_event = _fifo;
+				_fifo = _event->inbox_next;
+				_event->inbox_next = nullptr;
+
+				uint64_t _sync = _event->sync.fetch_and(~uint64_t(TIMER_SYNC_QUEUED), std::memory_order_acq_rel);
+				if (_sync & TIMER_SYNC_CANCEL)
+				{
+					//! erased eagerly even in lazy mode, update() may have popped it meanwhile
+					if (!(_sync & TIMER_SYNC_PENDING)){
+						unqueue_event(_event);
+					}
+					release_event(_event);
+					metrics_cancel();
+				}
+				else if (_sync & TIMER_SYNC_PENDING)
+				{
+					_event->tp_ += now_;
+					_event->sync.fetch_and(~uint64_t(TIMER_SYNC_PENDING), std::memory_order_release);
+					enqueue_event(_event);
+					metrics_add(1);
+				}
+			}
+		}
+
+		bool Timer::claim_event(TimerEvent *e)
+		{
+			uint64_t _sync = e->sync.load(std::memory_order_acquire);
+			do
+			{
+				//! cancelled from another thread, the inbox owns the slot now
+				if (_sync & TIMER_SYNC_CANCEL){
+					return false;
+				}
+			} while (!e->sync.compare_exchange_weak(_sync, _sync | TIMER_SYNC_FIRED, std::memory_order_acq_rel, std::memory_order_acquire));
+			return true;
+		}
+
+		void Timer::enqueue_event(TimerEvent *e)
+		{
+			if (!e->slack_)
+			{
+				push_event(e);
+				return;
+			}
+
+			int64_t _tick = (e->tp_ + e->slack_ - 1) & ~int64_t(e->slack_ - 1);
+			TimerEvent *&_bucket = buckets_[_tick];
+			if (!_bucket)
+			{
+				_bucket = alloc_event();
+				_bucket->tp_ = _tick;
+				_bucket->bucket_prev = _bucket->bucket_next = _bucket;
+				push_event(_bucket);
+			}
+
+			e->tp_ = _tick;
+			e->bucket_ = _bucket;
+			e->bucket_next = _bucket;
+			e->bucket_prev = _bucket->bucket_prev;
+			_bucket->bucket_prev->bucket_next = e;
+			_bucket->bucket_prev = e;
+		}
+
+		void Timer::unqueue_event(TimerEvent *e)
+		{
+			TimerEvent *_bucket = e->bucket_;
+			if (!_bucket)
+			{
+				erase_event(e);
+				return;
+			}
+
+			e->bucket_prev->bucket_next = e->bucket_next;
+			e->bucket_next->bucket_prev = e->bucket_prev;
+			e->bucket_ = e->bucket_prev = e->bucket_next = nullptr;
+
+			//! the last member is gone, unless fire_bucket is walking it (bucket_ == itself)
+			if (_bucket->bucket_next == _bucket && _bucket->bucket_ != _bucket)
+			{
+				forget_bucket(_bucket);
+				erase_event(_bucket);
+				release_event(_bucket);
+			}
+		}
+
+		void Timer::forget_bucket(TimerEvent *bucket)
+		{
+			//! a bucket left over by an exhausted budget may share its tick with a newer one
+			auto _it = buckets_.find(bucket->tp_);
+			if (_it != buckets_.end() && _it->second == bucket){
+				buckets_.erase(_it);
+			}
+		}
+
+		void Timer::fire_bucket(TimerEvent *bucket)
+		{
+			//! callbacks may add to a fresh bucket for the same tick, or remove members of this one
+			forget_bucket(bucket);
+			bucket->bucket_ = bucket;
+
+			while (bucket->bucket_next != bucket && budget_)
+			{
+				TimerEvent *_event = bucket->bucket_next;
+				_event->bucket_prev->bucket_next = _event->bucket_next;
+				_event->bucket_next->bucket_prev = _event->bucket_prev;
+				_event->bucket_ = _event->bucket_prev = _event->bucket_next = nullptr;
+
+				//! a cancel still in the inbox is released by drain_inbox
+				if (!claim_event(_event)){
+					continue;
+				}
+
+				if (pool_)
+				{
+					dispatch_event(_event);
+					continue;
+				}
+
+				int64_t _begin = metrics_fire_begin(_event);
+				_event->timer_callback_();
+				metrics_fire_end(_begin);
+				release_event(_event);
+				spend_budget();
+			}
+
+			//! out of budget, the rest of the members go first next time
+			if (bucket->bucket_next != bucket)
+			{
+				bucket->bucket_ = nullptr;
+				buckets_.emplace(bucket->tp_, bucket);
+				push_event(bucket);
+				return;
+			}
+
+			bucket->bucket_prev = bucket->bucket_next = bucket->bucket_ = nullptr;
+			release_event(bucket);
+		}
+
+		void Timer::spend_budget()
+		{
+			if (--budget_ && budget_end_ != std::chrono::steady_clock::time_point::max() && std::chrono::steady_clock::now() >= budget_end_){
+				budget_ = 0;
+			}
+		}
+
+		unsigned Timer::due_events()
+		{
+			auto _weight = [](TimerEvent *e) -> unsigned
+			{
+				if (!e->bucket_next){
+					return 1;
+				}
+				unsigned _n = 0;
+				for (TimerEvent *_it = e->bucket_next; _it != e; _it = _it->bucket_next){
+					++_n;
+				}
+				return _n;
+			};
+
+#if defined(GSF_TIMER_NEAR_BUFFER)
+			unsigned _near = near_buffer_count_below(&near_buffer_, now_, _weight);
+#else
+			unsigned _near = 0;
+#endif
+			return queue_.count_below(now_, _weight) + _near;
+		}
+
+		bool Timer::rearm_periodic(TimerEvent *e)
+		{
+			int64_t _tp = e->defer_;
+			if (_tp == INT64_MIN && e->period_ < 0)
+			{
+				//! the schedule has no firing left, FIRED is still held so update() releases it
+				_tp = calendar_deadline(static_cast<uint32_t>(-e->period_));
+				if (_tp == INT64_MAX){
+					return false;
+				}
+			}
+			else if (_tp == INT64_MIN)
+			{
+				_tp = e->tp_ + e->period_;
+				if (_tp < now_){
+					_tp += (now_ - _tp + e->period_ - 1) / e->period_ * e->period_;
+				}
+			}
+
+			//! drop FIRED unless rmv_timer stopped it during the callback
+			uint64_t _sync = e->sync.load(std::memory_order_acquire);
+			while (!(_sync & TIMER_SYNC_CANCEL))
+			{
+				if (e->sync.compare_exchange_weak(_sync, _sync & ~uint64_t(TIMER_SYNC_FIRED), std::memory_order_acq_rel, std::memory_order_acquire))
+				{
+					e->tp_ = _tp;
+					e->defer_ = INT64_MIN;
+					rearm_event(e);
+					return true;
+				}
+			}
+			return false;
+		}
+
+		void Timer::update()
+		{
+			update(clock_());
+		}
+
+		void Timer::update(int64_t now)
+		{
+			update(now, 0, std::chrono::microseconds::zero());
+		}
+
+		unsigned Timer::update(uint32_t max_events, std::chrono::microseconds max_duration)
+		{
+			return update(clock_(), max_events, max_duration);
+		}
+
+		unsigned Timer::update(int64_t now, uint32_t max_events, std::chrono::microseconds max_duration)
+		{
+			now_ = now;
+
+			budget_ = max_events ? max_events : UINT64_MAX;
+			budget_end_ = max_duration > std::chrono::microseconds::zero() ? std::chrono::steady_clock::now() + max_duration : std::chrono::steady_clock::time_point::max();
+
+			drain_inbox();
+			drain_done();
+
+			TimerEvent *_event_ptr = nullptr;
+			while (budget_ && (_event_ptr = pop_expired(now_)) != nullptr)
+			{
+				//! pushed back by reschedule() while queued, the move is paid for only now. a removed one goes now
+				if (_event_ptr->defer_ != INT64_MIN && !(_event_ptr->sync.load(std::memory_order_acquire) & TIMER_SYNC_CANCEL))
+				{
+					_event_ptr->tp_ = _event_ptr->defer_;
+					_event_ptr->defer_ = INT64_MIN;
+					rearm_event(_event_ptr);
+					continue;
+				}
+
+				if (_event_ptr->bucket_next)
+				{
+					fire_bucket(_event_ptr);
+					continue;
+				}
+
+				if (!claim_event(_event_ptr))
+				{
+					//! a tombstone, a cancel still in the inbox is released by drain_inbox
+					erase_event(_event_ptr);
+					if (!(_event_ptr->sync.load(std::memory_order_acquire) & TIMER_SYNC_QUEUED)){
+						--dead_;
+						release_event(_event_ptr);
+					}
+					continue;
+				}
+
+				if (pool_)
+				{
+					dispatch_event(_event_ptr);
+					continue;
+				}
+
+				int64_t _begin = metrics_fire_begin(_event_ptr);
+				_event_ptr->timer_callback_();
+				metrics_fire_end(_begin);
+				spend_budget();
+
+				if (_event_ptr->period_ && rearm_periodic(_event_ptr)){
+					continue;
+				}
+
+				erase_event(_event_ptr);
+				release_event(_event_ptr);
+			}
+
+			if (pool_ && pool_wait_){
+				wait_pool();
+			}
+
+			unsigned _backlog = budget_ ? 0 : due_events();
+
+			if (dead_ && dead_ > lazy_ratio_ * queued_events()){
+				sweep_events();
+			}
+
+			refill_reserve();
+			metrics_update();
+			return _backlog;
+		}
+
+		void Timer::use_pool(TimerPool *pool, bool wait)
+		{
+			if (pool_){
+				wait_pool();
+			}
+			pool_ = pool;
+			pool_wait_ = wait;
+		}
+
+		int Timer::set_order_key(TimerID id, uint64_t key)
+		{
+			if (timer_id_shard(id) != shard_ || !is_owner()){
+				return -1;
+			}
+
+			TimerEvent *_event = event_pool_get(&event_pool_, id);
+			if (!_event || (_event->sync.load(std::memory_order_acquire) & TIMER_SYNC_CANCEL)){
+				return -1;
+			}
+
+			//! a callback in flight keeps its worker, the key applies from the next firing
+			_event->key_ = key;
+			return 0;
+		}
+
+		void Timer::dispatch_event(TimerEvent *e)
+		{
+			//! off the queue while in flight, finish_event re-arms a periodic timer
+			if (e->period_){
+				erase_event(e);
+			}
+
+			metrics_dispatch(e);
+			in_flight_.fetch_add(1, std::memory_order_relaxed);
+
+			timer_task _task = { &Timer::run_task, this, e };
+			pool_->submit(_task, e->key_);
+			spend_budget();
+		}
+
+		void Timer::run_task(void *ctx, void *arg)
+		{
+			Timer *_timer = static_cast<Timer*>(ctx);
+			TimerEvent *_event = static_cast<TimerEvent*>(arg);
+
+			_event->timer_callback_();
+
+			TimerEvent *_head = _timer->done_.load(std::memory_order_relaxed);
+			do
+			{
+				_event->inbox_next = _head;
+			} while (!_timer->done_.compare_exchange_weak(_head, _event, std::memory_order_release, std::memory_order_relaxed));
+
+			//! last touch of the Timer, ~Timer may run right after
+			_timer->in_flight_.fetch_sub(1, std::memory_order_release);
+		}
+
+		void Timer::drain_done()
+		{
+			TimerEvent *_list = done_.exchange(nullptr, std::memory_order_acquire);
+			while (_list)
+			{
+				TimerEvent *_event = _list;
+				_list = _event->inbox_next;
+				_event->inbox_next = nullptr;
+				finish_event(_event);
+			}
+		}
+
+		void Timer::finish_event(TimerEvent *e)
+		{
+			if (e->period_ && rearm_periodic(e)){
+				return;
+			}
+			release_event(e);
+		}
+
+		void Timer::wait_pool()
+		{
+			//! only unkeyed callbacks can be run here, keyed ones must stay on their worker
+			while (in_flight_.load(std::memory_order_acquire))
+			{
+				if (!pool_->run_one()){
+					std::this_thread::yield();
+				}
+			}
+			drain_done();
+		}
+
+		template <typename F>
+		void Timer::visit_events(F fn)
+		{
+			auto _visit = [&fn](TimerEvent *e) -> unsigned
+			{
+				fn(e);
+				return 0;
+			};
+
+			queue_.count_below(INT64_MAX, _visit);
+#if defined(GSF_TIMER_NEAR_BUFFER)
+			near_buffer_count_below(&near_buffer_, INT64_MAX, _visit);
+#endif
+		}
+
+		int64_t Timer::snapshot(const char *path)
+		{
+			if (!is_owner()){
+				return -1;
+			}
+			drain_inbox();
+
+			std::vector<TimerEvent*> _events;
+			uint64_t _bytes = sizeof(timer_snapshot_header);
+			auto _collect = [&_events, &_bytes](TimerEvent *e)
+			{
+				const TimerRecord *_record = e->timer_callback_.target<TimerRecord>();
+				if (!_record || (e->sync.load(std::memory_order_acquire) & (TIMER_SYNC_CANCEL | TIMER_SYNC_FIRED))){
+					return;
+				}
+				_events.push_back(e);
+				_bytes += timer_snapshot_entry_size(_record->size(), e->period_ < 0);
+			};
+
+			visit_events([&_collect](TimerEvent *e)
+			{
+				if (!e->bucket_next)
+				{
+					_collect(e);
+					return;
+				}
+				for (TimerEvent *_it = e->bucket_next; _it != e; _it = _it->bucket_next){
+					_collect(_it);
+				}
+			});
+
+			timer_snapshot_file _file;
+			if (timer_snapshot_create(&_file, path, _bytes)){
+				return -1;
+			}
+
+			timer_snapshot_header *_header = reinterpret_cast<timer_snapshot_header*>(_file.p);
+			_header->magic = TIMER_SNAPSHOT_MAGIC;
+			_header->version = TIMER_SNAPSHOT_VERSION;
+			_header->count = _events.size();
+			_header->bytes = _bytes;
+			_header->wall = system_clock_source::now();
+			int64_t _tick = clock_();
+
+			char *_p = _file.p + sizeof(timer_snapshot_header);
+			for (size_t i = 0; i < _events.size(); ++i)
+			{
+				TimerEvent *_event = _events[i];
+				const TimerRecord *_record = _event->timer_callback_.target<TimerRecord>();
+				bool _calendar = _event->period_ < 0;
+
+				timer_snapshot_entry *_entry = reinterpret_cast<timer_snapshot_entry*>(_p);
+				_entry->due = (_event->defer_ != INT64_MIN ? _event->defer_ : _event->tp_) - _tick;
+				_entry->period = _calendar ? 0 : _event->period_;
+				_entry->key = _event->key_;
+				_entry->type = _record->type();
+				_entry->size = _record->size();
+				_entry->slack = _event->slack_;
+				_entry->flags = _calendar ? TIMER_SNAPSHOT_CALENDAR : 0;
+
+				char *_data = _p + sizeof(timer_snapshot_entry);
+				if (_calendar)
+				{
+					memcpy(_data, calendar_at(static_cast<uint32_t>(-_event->period_)), sizeof(calendar_schedule));
+					_data += sizeof(calendar_schedule);
+				}
+				memcpy(_data, _record->data(), _record->size());
+				_p += timer_snapshot_entry_size(_record->size(), _calendar);
+			}
+
+			if (timer_snapshot_commit(&_file, path)){
+				return -1;
+			}
+			return static_cast<int64_t>(_events.size());
+		}
+
+		int64_t Timer::restore(const char *path)
+		{
+			return restore(path, [](TimerID, const TimerRecord &) {});
+		}
+
+		template <typename F>
+		int64_t Timer::restore(const char *path, F on_timer)
+		{
+			timer_snapshot_file _file;
+			if (!is_owner() || timer_snapshot_open(&_file, path)){
+				return -1;
+			}
+
+			const timer_snapshot_header *_header = reinterpret_cast<const timer_snapshot_header*>(_file.p);
+			int64_t _base = clock_() - (system_clock_source::now() - _header->wall);
+
+			//! exact timers are appended and heapified once, coalesced ones join their buckets afterwards
+			unsigned _from = 0;
+			bool _bulk = 0 == reserve_events(static_cast<unsigned>(_header->count), _from);
+			int64_t _restored = 0;
+
+			for (int _pass = 0; _pass < 2; ++_pass)
+			{
+				const char *_p = _file.p + sizeof(timer_snapshot_header);
+				for (uint64_t i = 0; i < _header->count; ++i)
+				{
+					const timer_snapshot_entry *_entry = reinterpret_cast<const timer_snapshot_entry*>(_p);
+					bool _calendar = (_entry->flags & TIMER_SNAPSHOT_CALENDAR) != 0;
+					const char *_data = _p + sizeof(timer_snapshot_entry);
+					_p += timer_snapshot_entry_size(_entry->size, _calendar);
+
+					uint32_t _slack = _entry->period || _calendar ? 0 : _entry->slack;
+					if ((_slack != 0) != (_pass == 1)){
+						continue;
+					}
+
+					int64_t _period = _entry->period;
+					if (_period < 0 && !_calendar){
+						continue;	//! only alloc_event reads a negative period, as a calendar id the file doesn't carry
+					}
+					if (_calendar)
+					{
+						calendar_schedule _schedule;
+						memcpy(&_schedule, _data, sizeof(_schedule));
+						_data += sizeof(_schedule);
+						_period = -int64_t(calendar_intern(_schedule));
+						if (!_period){
+							continue;
+						}
+					}
+
+					TimerEvent *_event = alloc_event(_period);
+					_event->timer_callback_ = TimerRecord(_entry->type, _data, _entry->size);
+					_event->tp_ = _base + _entry->due;
+					_event->key_ = _entry->key;
+					_event->slack_ = _slack;
+
+					if (_slack){
+						enqueue_event(_event);
+					}
+					else if (_bulk){
+						append_event(_event);
+					}
+					else {
+						push_event(_event);
+					}
+
+					on_timer(make_id(_event), *_event->timer_callback_.target<TimerRecord>());
+					++_restored;
+				}
+
+				if (_pass == 0 && _bulk){
+					heapify_events(_from);
+				}
+			}
+
+			timer_snapshot_close(&_file);
+			metrics_add(static_cast<uint64_t>(_restored));
+			return _restored;
+		}
+
+		void Timer::metrics_add(uint64_t n)
+		{
+#if defined(GSF_TIMER_METRICS)
+			metrics_.added += n;
+			uint64_t _pending = queued_events();
+			if (_pending > metrics_.peak_pending){
+				metrics_.peak_pending = _pending;
+			}
+#else
+			(void)n;
+#endif
+		}
+
+		void Timer::metrics_cancel()
+		{
+#if defined(GSF_TIMER_METRICS)
+			++metrics_.cancelled;
+#endif
+		}
+
+		int64_t Timer::metrics_fire_begin(const TimerEvent *e)
+		{
+#if defined(GSF_TIMER_METRICS)
+			timer_histogram_record(&metrics_.lateness, static_cast<uint64_t>(now_ - e->tp_));
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#else
+			(void)e;
+			return 0;
+#endif
+		}
+
+		void Timer::metrics_fire_end(int64_t begin)
+		{
+#if defined(GSF_TIMER_METRICS)
+			int64_t _end = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+			timer_histogram_record(&metrics_.callback_ns, static_cast<uint64_t>(_end - begin));
+			++metrics_.fired;
+			++update_fired_;
+#else
+			(void)begin;
+#endif
+		}
+
+		void Timer::metrics_dispatch(const TimerEvent *e)
+		{
+#if defined(GSF_TIMER_METRICS)
+			//! the callback runs on a worker, only the lateness is known here
+			timer_histogram_record(&metrics_.lateness, static_cast<uint64_t>(now_ - e->tp_));
+			++metrics_.fired;
+			++update_fired_;
+#else
+			(void)e;
+#endif
+		}
+
+		void Timer::metrics_update()
+		{
+#if defined(GSF_TIMER_METRICS)
+			++metrics_.updates;
+			timer_histogram_record(&metrics_.fired_per_update, update_fired_);
+			update_fired_ = 0;
+#endif
+		}
+
+#if defined(GSF_TIMER_METRICS)
+		void Timer::metrics(timer_metrics &out)
+		{
+			out = metrics_;
+			out.now = now_;
+			out.pending = queued_events();
+		}
+
+		void Timer::reset_metrics()
+		{
+			memset(&metrics_, 0, sizeof(metrics_));
+			update_fired_ = 0;
+		}
+#endif
+
 
-		gsf::utils::Timer * gsf::utils::Timer::instance_ = nullptr;
 	}
 }
 
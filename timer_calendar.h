@@ -0,0 +1,630 @@
+#ifndef _TIMER_CALENDAR_HEADER_
+#define _TIMER_CALENDAR_HEADER_
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace gsf
+{
+	namespace utils
+	{
+		/**!
+			calendar schedules
+			a schedule is compiled once into bit sets (cron semantics: minute, hour,
+			day of month, month, day of week). the next firing is found with a few
+			bit scans per month instead of walking minutes, and local wall time is
+			mapped to utc through a zone table built ahead of time, so no localtime
+			call happens per timer.
+
+			day of month and day of week: if both are restricted a day matching
+			either one fires, otherwise the restricted one decides (as in cron).
+			a month without the requested day (e.g. the 31st) is skipped.
+		*/
+
+		enum
+		{
+			CALENDAR_MDAY_ANY = 1,		//! day of month field was '*'
+			CALENDAR_WDAY_ANY = 2,		//! day of week field was '*'
+
+			CALENDAR_SEARCH_MONTHS = 12 * 9,	//! enough for feb 29 across a skipped leap year
+			CALENDAR_ZONE_YEARS = 20,			//! system zone rules are tabled this far ahead
+		};
+
+		struct calendar_schedule
+		{
+			uint64_t minutes;	//! bit m, 0..59
+			uint32_t hours;		//! bit h, 0..23
+			uint32_t mdays;		//! bit d, 1..31
+			uint16_t months;	//! bit m, 1..12
+			uint8_t wdays;		//! bit w, 0..6, sunday is 0
+			uint8_t flags;		//! CALENDAR_*_ANY
+		};
+
+		/**!
+			zone table
+			utc offsets (ms) with the transitions between them, sorted by utc.
+			offset applies before the first transition, fixed zones have none.
+		*/
+		struct calendar_transition
+		{
+			int64_t utc;
+			int64_t before;
+			int64_t after;
+		};
+
+		struct calendar_zone
+		{
+			int64_t offset;
+			std::vector<calendar_transition> transitions;
+		};
+
+		inline calendar_schedule calendar_daily(uint32_t hour, uint32_t minute);
+
+		//! wday 0..7, sunday is 0 or 7
+		inline calendar_schedule calendar_weekly(uint32_t wday, uint32_t hour, uint32_t minute);
+
+		inline calendar_schedule calendar_monthly(uint32_t mday, uint32_t hour, uint32_t minute);
+
+		/**!
+			"minute hour day-of-month month day-of-week", each field a list of *, n
+			or a-b, optionally followed by /step. months and weekdays also take
+			jan..dec and sun..sat. @hourly @daily @weekly @monthly @yearly too.
+			0 succ, -1 if expr is malformed (s is left empty, it never matches).
+		*/
+		inline int	     calendar_parse(calendar_schedule* s, const char* expr);
+
+		//! utc ms of the first firing strictly after utc, INT64_MAX if s never matches
+		inline int64_t	 calendar_next(const calendar_schedule* s, const calendar_zone* z, int64_t utc);
+
+		//! minutes east of utc, no daylight saving
+		inline void	     calendar_zone_fixed(calendar_zone* z, int32_t minutes);
+
+		//! table the system's local rules from a year ago to CALENDAR_ZONE_YEARS ahead
+		inline void	     calendar_zone_system(calendar_zone* z);
+
+		//! the system zone, built on first use and shared by the process
+		inline const calendar_zone* calendar_zone_local();
+
+		inline int64_t	 calendar_zone_offset(const calendar_zone* z, int64_t utc);
+
+		/**!
+			utc of a local wall time. a time skipped by a forward jump maps to the
+			jump itself, a repeated one to its first occurrence.
+		*/
+		inline int64_t	 calendar_zone_utc(const calendar_zone* z, int64_t local);
+
+		/**!
+			schedule registry
+			process wide, append only. an id (> 0) stands for a schedule in a few
+			bits, lookups are lock free. 0 once CALENDAR_REGISTRY_MAX distinct
+			schedules are registered.
+		*/
+		enum
+		{
+			CALENDAR_REGISTRY_CHUNK_BITS = 8,
+			CALENDAR_REGISTRY_CHUNK_SIZE = 1 << CALENDAR_REGISTRY_CHUNK_BITS,
+			CALENDAR_REGISTRY_MAX = CALENDAR_REGISTRY_CHUNK_SIZE * 256,
+		};
+
+		inline uint32_t	 calendar_intern(const calendar_schedule& s);
+
+		inline const calendar_schedule* calendar_at(uint32_t id);
+
+		inline int	     calendar_ctz_(uint64_t v);
+
+		inline int64_t	 calendar_floor_div_(int64_t a, int64_t b);
+
+		inline int64_t	 calendar_days_from_civil_(int64_t y, uint32_t m, uint32_t d);
+
+		inline void	     calendar_civil_from_days_(int64_t days, int64_t& y, uint32_t& m, uint32_t& d);
+
+		inline uint32_t	 calendar_month_days_(int64_t y, uint32_t m);
+
+		inline int64_t	 calendar_match_(const calendar_schedule* s, int64_t minute);
+
+		inline int	     calendar_field_(const char*& p, uint64_t& bits, uint32_t lo, uint32_t hi, const char* const* names);
+
+		inline int64_t	 calendar_system_offset_(int64_t t);
+
+		int calendar_ctz_(uint64_t v)
+		{
+#if defined(__GNUC__)
+			return __builtin_ctzll(v);
+#else
+			int n = 0;
+			while (!(v & 1))
+			{
+				v >>= 1;
+				++n;
+			}
+			return n;
+#endif
+		}
+
+		int64_t calendar_floor_div_(int64_t a, int64_t b)
+		{
+			int64_t q = a / b;
+			return (a % b < 0) ? q - 1 : q;
+		}
+
+		//! days since 1970-01-01 of a proleptic gregorian date
+		int64_t calendar_days_from_civil_(int64_t y, uint32_t m, uint32_t d)
+		{
+			y -= m <= 2;
+			int64_t era = calendar_floor_div_(y, 400);
+			int64_t yoe = y - era * 400;
+			int64_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+			int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+			return era * 146097 + doe - 719468;
+		}
+
+		void calendar_civil_from_days_(int64_t days, int64_t& y, uint32_t& m, uint32_t& d)
+		{
+			days += 719468;
+			int64_t era = calendar_floor_div_(days, 146097);
+			int64_t doe = days - era * 146097;
+			int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+			int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+			int64_t mp = (5 * doy + 2) / 153;
+			d = static_cast<uint32_t>(doy - (153 * mp + 2) / 5 + 1);
+			m = static_cast<uint32_t>(mp < 10 ? mp + 3 : mp - 9);
+			y = yoe + era * 400 + (m <= 2);
+		}
+
+		uint32_t calendar_month_days_(int64_t y, uint32_t m)
+		{
+			static const uint8_t days[13] = { 0, 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+			if (m == 2 && (y % 4 == 0 && (y % 100 != 0 || y % 400 == 0)))
+				return 29;
+			return days[m];
+		}
+
+		calendar_schedule calendar_daily(uint32_t hour, uint32_t minute)
+		{
+			calendar_schedule s;
+			s.minutes = minute < 60 ? uint64_t(1) << minute : 0;
+			s.hours = hour < 24 ? 1u << hour : 0;
+			s.mdays = 0xfffffffe;
+			s.months = 0x1ffe;
+			s.wdays = 0x7f;
+			s.flags = CALENDAR_MDAY_ANY | CALENDAR_WDAY_ANY;
+			return s;
+		}
+
+		calendar_schedule calendar_weekly(uint32_t wday, uint32_t hour, uint32_t minute)
+		{
+			calendar_schedule s = calendar_daily(hour, minute);
+			s.wdays = wday <= 7 ? static_cast<uint8_t>(1u << (wday % 7)) : 0;
+			s.flags = CALENDAR_MDAY_ANY;
+			return s;
+		}
+
+		calendar_schedule calendar_monthly(uint32_t mday, uint32_t hour, uint32_t minute)
+		{
+			calendar_schedule s = calendar_daily(hour, minute);
+			s.mdays = (mday >= 1 && mday <= 31) ? 1u << mday : 0;
+			s.flags = CALENDAR_WDAY_ANY;
+			return s;
+		}
+
+		//! one field into bits lo..hi, p is left on the character after it
+		int calendar_field_(const char*& p, uint64_t& bits, uint32_t lo, uint32_t hi, const char* const* names)
+		{
+			bits = 0;
+			for (;;)
+			{
+				uint32_t a = lo, b = hi, step = 1;
+				bool single = false;
+				if (*p == '*')
+				{
+					++p;
+				}
+				else
+				{
+					uint32_t* ends[2] = { &a, &b };
+					for (int i = 0; i < 2; ++i)
+					{
+						uint32_t v = 0;
+						if (*p >= '0' && *p <= '9')
+						{
+							while (*p >= '0' && *p <= '9')
+							{
+								v = v * 10 + (*p++ - '0');
+								if (v > 1000)
+									return -1;
+							}
+						}
+						else
+						{
+							uint32_t k = 0;
+							for (; names && names[k]; ++k)
+							{
+								if ((p[0] | 0x20) == names[k][0] && (p[1] | 0x20) == names[k][1] && (p[2] | 0x20) == names[k][2])
+									break;
+							}
+							if (!names || !names[k])
+								return -1;
+							v = lo + k;
+							p += 3;
+						}
+						*ends[i] = v;
+						if (i == 0)
+						{
+							b = v;
+							if (*p != '-')
+							{
+								single = true;
+								break;
+							}
+							++p;
+						}
+					}
+				}
+
+				if (*p == '/')
+				{
+					++p;
+					step = 0;
+					while (*p >= '0' && *p <= '9')
+					{
+						step = step * 10 + (*p++ - '0');
+						if (step > 1000)
+							return -1;
+					}
+					if (!step)
+						return -1;
+					//! n/step runs from n to the end of the range
+					if (single)
+						b = hi;
+				}
+
+				if (a < lo || b > hi || a > b)
+					return -1;
+				for (uint32_t v = a; v <= b; v += step)
+					bits |= uint64_t(1) << v;
+
+				if (*p != ',')
+					return 0;
+				++p;
+			}
+		}
+
+		int calendar_parse(calendar_schedule* s, const char* expr)
+		{
+			static const char* months[] = { "jan", "feb", "mar", "apr", "may", "jun", "jul", "aug", "sep", "oct", "nov", "dec", 0 };
+			static const char* wdays[] = { "sun", "mon", "tue", "wed", "thu", "fri", "sat", 0 };
+			static const char* macros[][2] = {
+				{ "@hourly", "0 * * * *" }, { "@daily", "0 0 * * *" }, { "@midnight", "0 0 * * *" },
+				{ "@weekly", "0 0 * * 0" }, { "@monthly", "0 0 1 * *" }, { "@yearly", "0 0 1 1 *" }, { "@annually", "0 0 1 1 *" },
+			};
+
+			memset(s, 0, sizeof(*s));
+			if (!expr)
+				return -1;
+			while (*expr == ' ' || *expr == '\t')
+				++expr;
+			if (*expr == '@')
+			{
+				for (size_t i = 0; i < sizeof(macros) / sizeof(macros[0]); ++i)
+				{
+					if (0 == strcmp(expr, macros[i][0]))
+						return calendar_parse(s, macros[i][1]);
+				}
+				return -1;
+			}
+
+			static const uint32_t lo[5] = { 0, 0, 1, 1, 0 };
+			static const uint32_t hi[5] = { 59, 23, 31, 12, 7 };
+			const char* const* names[5] = { 0, 0, 0, months, wdays };
+			uint64_t bits[5];
+			uint8_t flags = 0;
+
+			const char* p = expr;
+			for (int i = 0; i < 5; ++i)
+			{
+				while (*p == ' ' || *p == '\t')
+					++p;
+				if (i == 2 && *p == '*')
+					flags |= CALENDAR_MDAY_ANY;
+				if (i == 4 && *p == '*')
+					flags |= CALENDAR_WDAY_ANY;
+				if (calendar_field_(p, bits[i], lo[i], hi[i], names[i]))
+					return -1;
+				if (*p && *p != ' ' && *p != '\t')
+					return -1;
+			}
+			while (*p == ' ' || *p == '\t')
+				++p;
+			if (*p)
+				return -1;
+
+			s->minutes = bits[0];
+			s->hours = static_cast<uint32_t>(bits[1]);
+			s->mdays = static_cast<uint32_t>(bits[2]);
+			s->months = static_cast<uint16_t>(bits[3]);
+			s->wdays = static_cast<uint8_t>((bits[4] | (bits[4] >> 7)) & 0x7f);
+			s->flags = flags;
+			return 0;
+		}
+
+		//! first local minute (since the epoch) >= minute that s matches, INT64_MAX if none
+		int64_t calendar_match_(const calendar_schedule* s, int64_t minute)
+		{
+			if (!s->minutes || !s->hours || !s->months || (!s->mdays && !s->wdays))
+				return INT64_MAX;
+
+			int64_t days = calendar_floor_div_(minute, 1440);
+			uint32_t hour = static_cast<uint32_t>(minute - days * 1440) / 60;
+			uint32_t min = static_cast<uint32_t>(minute - days * 1440) % 60;
+
+			int64_t y;
+			uint32_t m, d;
+			calendar_civil_from_days_(days, y, m, d);
+
+			for (int i = 0; i < CALENDAR_SEARCH_MONTHS; ++i)
+			{
+				if (s->months & (1u << m))
+				{
+					int64_t first = calendar_days_from_civil_(y, m, 1);
+					uint32_t dim = calendar_month_days_(y, m);
+
+					//! weekday bits repeated over the month, day 1 at bit 1
+					uint32_t wday1 = static_cast<uint32_t>(((first + 4) % 7 + 7) % 7);
+					uint64_t week = ((uint64_t(s->wdays) | (uint64_t(s->wdays) << 7)) >> wday1) & 0x7f;
+					uint32_t by_wday = static_cast<uint32_t>(((week | week << 7 | week << 14 | week << 21 | week << 28) << 1) & 0xfffffffe);
+
+					uint32_t days_mask;
+					if ((s->flags & (CALENDAR_MDAY_ANY | CALENDAR_WDAY_ANY)) == (CALENDAR_MDAY_ANY | CALENDAR_WDAY_ANY))
+						days_mask = 0xfffffffe;
+					else if (s->flags & CALENDAR_MDAY_ANY)
+						days_mask = by_wday;
+					else if (s->flags & CALENDAR_WDAY_ANY)
+						days_mask = s->mdays;
+					else
+						days_mask = s->mdays | by_wday;
+
+					days_mask &= static_cast<uint32_t>((uint64_t(2) << dim) - 2);
+					days_mask &= ~((1u << d) - 1);
+
+					while (days_mask)
+					{
+						uint32_t dd = static_cast<uint32_t>(calendar_ctz_(days_mask));
+						if (dd != d)
+						{
+							hour = 0;
+							min = 0;
+						}
+
+						uint32_t hours = s->hours & ~((1u << hour) - 1);
+						if (hours)
+						{
+							uint32_t hh = static_cast<uint32_t>(calendar_ctz_(hours));
+							uint64_t mins = s->minutes & ~((uint64_t(1) << (hh == hour ? min : 0)) - 1);
+							if (!mins)
+							{
+								//! nothing left in this hour, the next one starts at its first minute
+								hours &= hours - 1;
+								mins = s->minutes;
+								if (!hours)
+								{
+									days_mask &= days_mask - 1;
+									d = 0;
+									continue;
+								}
+								hh = static_cast<uint32_t>(calendar_ctz_(hours));
+							}
+							return (first + dd - 1) * 1440 + hh * 60 + calendar_ctz_(mins);
+						}
+
+						days_mask &= days_mask - 1;
+						d = 0;
+					}
+				}
+
+				if (++m > 12)
+				{
+					m = 1;
+					++y;
+				}
+				d = 1;
+				hour = 0;
+				min = 0;
+			}
+			return INT64_MAX;
+		}
+
+		int64_t calendar_next(const calendar_schedule* s, const calendar_zone* z, int64_t utc)
+		{
+			int64_t minute = calendar_floor_div_(utc + calendar_zone_offset(z, utc), 60000) + 1;
+			for (;;)
+			{
+				int64_t local = calendar_match_(s, minute);
+				if (local == INT64_MAX)
+					return INT64_MAX;
+
+				//! inside an hour repeated by a backward jump the first occurrences are behind us
+				int64_t next = calendar_zone_utc(z, local * 60000);
+				if (next > utc)
+					return next;
+				minute = local + 1;
+			}
+		}
+
+		void calendar_zone_fixed(calendar_zone* z, int32_t minutes)
+		{
+			z->offset = int64_t(minutes) * 60000;
+			z->transitions.clear();
+		}
+
+		//! seconds east of utc at t, from the c library
+		int64_t calendar_system_offset_(int64_t t)
+		{
+			time_t tt = static_cast<time_t>(t);
+			struct tm tm;
+#if defined(WIN32) || defined(_WIN32)
+			localtime_s(&tm, &tt);
+#else
+			localtime_r(&tt, &tm);
+#endif
+			int64_t local = calendar_days_from_civil_(tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday) * 86400 + tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec;
+			return local - t;
+		}
+
+		void calendar_zone_system(calendar_zone* z)
+		{
+			int64_t begin = static_cast<int64_t>(time(0)) - 366 * 86400;
+			int64_t end = begin + (CALENDAR_ZONE_YEARS + 1) * int64_t(366 * 86400);
+
+			//! one probe a day, a change is then narrowed down to the second
+			int64_t prev = calendar_system_offset_(begin);
+			z->offset = prev * 1000;
+			z->transitions.clear();
+			for (int64_t t = begin + 86400; t <= end; t += 86400)
+			{
+				int64_t off = calendar_system_offset_(t);
+				if (off == prev)
+					continue;
+
+				int64_t lo = t - 86400, hi = t;
+				while (hi - lo > 1)
+				{
+					int64_t mid = lo + (hi - lo) / 2;
+					if (calendar_system_offset_(mid) == prev)
+						lo = mid;
+					else
+						hi = mid;
+				}
+
+				calendar_transition tr = { hi * 1000, prev * 1000, off * 1000 };
+				z->transitions.push_back(tr);
+				prev = off;
+			}
+		}
+
+		const calendar_zone* calendar_zone_local()
+		{
+			struct local_zone
+			{
+				local_zone() { calendar_zone_system(&zone); }
+				calendar_zone zone;
+			};
+			static local_zone _local;
+			return &_local.zone;
+		}
+
+		int64_t calendar_zone_offset(const calendar_zone* z, int64_t utc)
+		{
+			size_t lo = 0, hi = z->transitions.size();
+			while (lo < hi)
+			{
+				size_t mid = (lo + hi) / 2;
+				if (z->transitions[mid].utc <= utc)
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+			return lo ? z->transitions[lo - 1].after : z->offset;
+		}
+
+		int64_t calendar_zone_utc(const calendar_zone* z, int64_t local)
+		{
+			//! last transition whose earliest local image is at or before local
+			size_t lo = 0, hi = z->transitions.size();
+			while (lo < hi)
+			{
+				size_t mid = (lo + hi) / 2;
+				const calendar_transition& t = z->transitions[mid];
+				if (t.utc + (t.before < t.after ? t.before : t.after) <= local)
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+			if (!lo)
+				return local - z->offset;
+
+			const calendar_transition& t = z->transitions[lo - 1];
+			if (local < t.utc + t.after)
+			{
+				//! skipped (forward jump) or first occurrence (backward jump)
+				return t.after > t.before ? t.utc : local - t.before;
+			}
+			if (local < t.utc + t.before)
+				return local - t.before;
+			return local - t.after;
+		}
+
+		struct calendar_registry_
+		{
+			calendar_registry_() : n(0)
+			{
+				for (uint32_t i = 0; i < CALENDAR_REGISTRY_MAX / CALENDAR_REGISTRY_CHUNK_SIZE; ++i)
+					chunks[i].store(0, std::memory_order_relaxed);
+			}
+
+			~calendar_registry_()
+			{
+				for (uint32_t i = 0; i < CALENDAR_REGISTRY_MAX / CALENDAR_REGISTRY_CHUNK_SIZE; ++i)
+					delete[] chunks[i].load(std::memory_order_relaxed);
+			}
+
+			std::mutex lock;
+			std::atomic<uint32_t> n;
+			std::atomic<calendar_schedule*> chunks[CALENDAR_REGISTRY_MAX / CALENDAR_REGISTRY_CHUNK_SIZE];
+		};
+
+		inline calendar_registry_& calendar_registry()
+		{
+			static calendar_registry_ _registry;
+			return _registry;
+		}
+
+		const calendar_schedule* calendar_at(uint32_t id)
+		{
+			calendar_registry_& r = calendar_registry();
+			if (!id || id > r.n.load(std::memory_order_acquire))
+				return 0;
+			--id;
+			return &r.chunks[id >> CALENDAR_REGISTRY_CHUNK_BITS].load(std::memory_order_acquire)[id & (CALENDAR_REGISTRY_CHUNK_SIZE - 1)];
+		}
+
+		uint32_t calendar_intern(const calendar_schedule& s)
+		{
+			calendar_registry_& r = calendar_registry();
+			auto find = [&s](uint32_t from, uint32_t to) -> uint32_t
+			{
+				for (uint32_t id = from + 1; id <= to; ++id)
+				{
+					const calendar_schedule* c = calendar_at(id);
+					if (c->minutes == s.minutes && c->hours == s.hours && c->mdays == s.mdays
+						&& c->months == s.months && c->wdays == s.wdays && c->flags == s.flags)
+						return id;
+				}
+				return 0;
+			};
+
+			//! published entries never change, only a miss takes the lock
+			uint32_t n = r.n.load(std::memory_order_acquire);
+			uint32_t id = find(0, n);
+			if (id)
+				return id;
+
+			std::lock_guard<std::mutex> guard(r.lock);
+			uint32_t now = r.n.load(std::memory_order_relaxed);
+			if ((id = find(n, now)) != 0 || now == CALENDAR_REGISTRY_MAX)
+				return id;
+
+			std::atomic<calendar_schedule*>& chunk = r.chunks[now >> CALENDAR_REGISTRY_CHUNK_BITS];
+			if (!chunk.load(std::memory_order_relaxed))
+				chunk.store(new calendar_schedule[CALENDAR_REGISTRY_CHUNK_SIZE], std::memory_order_release);
+			chunk.load(std::memory_order_relaxed)[now & (CALENDAR_REGISTRY_CHUNK_SIZE - 1)] = s;
+			r.n.store(now + 1, std::memory_order_release);
+			return now + 1;
+		}
+	}
+}
+
+#endif
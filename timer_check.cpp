@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <stdint.h>
+#include "timer.h"
+
+#include <stddef.h>
+
+/**!
+	regression checks for Timer
+	g++ -O2 -std=c++11 timer_check.cpp -o timer_check [-DGSF_TIMER_USE_TIMING_WHEEL | -DGSF_TIMER_USE_DARY_HEAP | -DGSF_TIMER_USE_RADIX_HEAP] [-DGSF_TIMER_USE_NEAR_BUFFER]
+	./timer_check
+
+	each case drives a private Timer through a fixed sequence with update(now)
+	and prints what went wrong. the exit code is the number of failed cases.
+*/
+
+using namespace gsf::utils;
+
+static int failed_ = 0;
+
+#define TIMER_CHECK(cond) \
+	do { if (!(cond)) { printf("%s:%d: %s\n", __FUNCTION__, __LINE__, #cond); ++failed_; return; } } while (0)
+
+//! reschedule later, remove lazily, then run past both deadlines: nothing fires, nothing stays queued
+static void check_reschedule_lazy_cancel()
+{
+	Timer timer;
+	timer.set_lazy_cancel(0.9);
+	int64_t now = timer.now();
+	timer.update(now);
+
+	int fired = 0;
+	TimerID id = timer.add_timer(delay_milliseconds(100), [&fired]() { ++fired; });
+	TimerID keep = timer.add_timer(delay_milliseconds(10000), []() {});
+	TIMER_CHECK(0 == timer.reschedule(id, delay_milliseconds(500)));
+	TIMER_CHECK(0 == timer.rmv_timer(id));
+
+	timer.update(now + 200);
+	TIMER_CHECK(0 == fired);
+	TIMER_CHECK(timer.next_deadline() > now + 600);
+
+	timer.update(now + 600);
+	TIMER_CHECK(0 == fired);
+	TIMER_CHECK(-1 == timer.rmv_timer(id));
+	TIMER_CHECK(0 == timer.rmv_timer(keep));
+}
+
+//! the same with a periodic timer rescheduled from its own callback
+static void check_reschedule_lazy_cancel_periodic()
+{
+	Timer timer;
+	timer.set_lazy_cancel(0.9);
+	int64_t now = timer.now();
+	timer.update(now);
+
+	int fired = 0;
+	TimerID id = 0;
+	id = timer.add_timer(delay_repeat(100, 100), [&]() { ++fired; timer.reschedule(id, delay_milliseconds(1000)); });
+
+	timer.update(now + 101);
+	TIMER_CHECK(1 == fired);
+	TIMER_CHECK(0 == timer.reschedule(id, delay_milliseconds(2000)));
+	TIMER_CHECK(0 == timer.rmv_timer(id));
+
+	timer.update(now + 5000);
+	TIMER_CHECK(1 == fired);
+	TIMER_CHECK(timer.next_deadline() == INT64_MAX);
+}
+
+static int record_hits_ = 0;
+static int record_add(uint64_t a, uint32_t b) { record_hits_ += static_cast<int>(a + b); return 0; }
+static void record_sub(uint64_t a, uint32_t b) { record_hits_ -= static_cast<int>(a + b); }
+
+//! a record only runs the handler it was made for, a non-void handler is called through its own type. one made for another handler isn't armed
+static void check_record_handler()
+{
+	registerTimerHandler(101, record_add);
+	registerTimerHandler(102, record_sub);
+
+	Timer timer;
+	int64_t now = timer.now();
+	timer.update(now);
+
+	TIMER_CHECK(0 != timer.add_timer(delay_milliseconds(1), makeTimerRecord(101, record_add, uint64_t(2), 3u)));
+	TimerCallback mismatched = makeTimerRecord(101, record_sub, uint64_t(100), 100u);
+	TIMER_CHECK(!mismatched);
+	TIMER_CHECK(0 == timer.add_timer(delay_milliseconds(1), std::move(mismatched)));
+	TIMER_CHECK(0 == timer.add_timer(delay_milliseconds(1), makeTimerRecord(103, record_sub, uint64_t(100), 100u)));
+
+	timer.update(now + 10);
+	TIMER_CHECK(5 == record_hits_);
+}
+
+//! a negative period in a non-calendar entry is corrupt, restore skips it instead of reading it as a calendar id
+static void check_restore_corrupt_period()
+{
+	registerTimerHandler(104, record_add);
+	const char *path = "timer_check.snap";
+
+	{
+		Timer timer;
+		timer.update(timer.now());
+		TIMER_CHECK(0 != timer.add_timer(delay_repeat(100, 100), makeTimerRecord(104, record_add, uint64_t(1), 1u)));
+		TIMER_CHECK(1 == timer.snapshot(path));
+	}
+
+	FILE *f = fopen(path, "r+b");
+	TIMER_CHECK(f != nullptr);
+	int64_t period = -7;
+	bool patched = 0 == fseek(f, sizeof(timer_snapshot_header) + offsetof(timer_snapshot_entry, period), SEEK_SET) && 1 == fwrite(&period, sizeof(period), 1, f);
+	fclose(f);
+	TIMER_CHECK(patched);
+
+	Timer timer;
+	int64_t now = timer.now();
+	timer.update(now);
+	int64_t restored = timer.restore(path);
+	remove(path);
+	TIMER_CHECK(0 == restored);
+
+	timer.update(now + 1000);
+	TIMER_CHECK(timer.next_deadline() == INT64_MAX);
+}
+
+int main()
+{
+	check_reschedule_lazy_cancel();
+	check_reschedule_lazy_cancel_periodic();
+	check_record_handler();
+	check_restore_corrupt_period();
+
+	printf("%s\n", failed_ ? "FAILED" : "ok");
+	return failed_;
+}
@@ -0,0 +1,62 @@
+#ifndef _TIMER_CLOCK_HEADER_
+#define _TIMER_CLOCK_HEADER_
+
+#include <stdint.h>
+#include <chrono>
+
+#if defined(__linux__)
+#include <time.h>
+#endif
+
+namespace gsf
+{
+	namespace utils
+	{
+		/**!
+			clock sources
+			a clock source is a type with a static now() returning integer
+			milliseconds. Timer stores deadlines as ticks of its clock source.
+		*/
+
+		//! monotonic, the default. immune to NTP steps and manual wall clock changes
+		struct steady_clock_source
+		{
+			static int64_t now()
+			{
+				using namespace std::chrono;
+				return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+			}
+		};
+
+		/**!
+			monotonic with jiffy resolution (CLOCK_MONOTONIC_COARSE, typically 1-4ms).
+			a few ns per read instead of a full clock_gettime. same epoch as
+			steady_clock_source on linux, falls back to it elsewhere.
+		*/
+		struct coarse_clock_source
+		{
+			static int64_t now()
+			{
+#if defined(__linux__) && defined(CLOCK_MONOTONIC_COARSE)
+				struct timespec ts;
+				clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+				return static_cast<int64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+#else
+				return steady_clock_source::now();
+#endif
+			}
+		};
+
+		//! wall clock, ms since the unix epoch. jumps with the system time
+		struct system_clock_source
+		{
+			static int64_t now()
+			{
+				using namespace std::chrono;
+				return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+			}
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef _TIMER_FD_HEADER_
+#define _TIMER_FD_HEADER_
+
+#include "timer.h"
+
+#if defined(__linux__)
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+namespace gsf
+{
+	namespace utils
+	{
+		/**!
+			timerfd driver
+			keeps a linux timerfd armed to the Timer's next deadline so an epoll loop
+			sleeps until work is due instead of calling update() every millisecond.
+
+				TimerFd timer_fd(Timer::instance());
+				epoll_ctl(epfd, EPOLL_CTL_ADD, timer_fd.fd(), &ev);	//! EPOLLIN
+				timer_fd.arm();
+				for (;;) {
+					epoll_wait(epfd, events, n, -1);
+					//! timer_fd.fd() readable -> timer_fd.on_readable()
+					//! after add_timer from the loop -> timer_fd.arm()
+				}
+
+			the fd is armed with relative times, so any clock source works.
+			add_timer from other threads doesn't wake the loop by itself.
+		*/
+		class TimerFd
+		{
+		public:
+			explicit TimerFd(Timer &timer);
+			~TimerFd();
+
+			//! -1 if timerfd_create failed
+			int fd() const { return fd_; }
+
+			//! re-arm if the next deadline moved earlier, a later one just costs a spurious wakeup
+			void arm();
+
+			//! read the expiration, update() the timer and re-arm
+			void on_readable();
+
+		private:
+			TimerFd(const TimerFd &);
+			TimerFd & operator = (const TimerFd &);
+
+			Timer &timer_;
+			int fd_;
+			int64_t armed_;	//! deadline the fd is set for, INT64_MAX when disarmed
+		};
+
+		TimerFd::TimerFd(Timer &timer)
+			: timer_(timer)
+			, fd_(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC))
+			, armed_(INT64_MAX)
+		{
+		}
+
+		TimerFd::~TimerFd()
+		{
+			if (fd_ >= 0){
+				close(fd_);
+			}
+		}
+
+		void TimerFd::arm()
+		{
+			int64_t _deadline = timer_.next_deadline();
+			if (fd_ < 0 || _deadline >= armed_){
+				return;
+			}
+
+			int _timeout = timer_.next_timeout();
+			if (_timeout < 0){
+				return;
+			}
+
+			struct itimerspec _spec = {};
+			_spec.it_value.tv_sec = _timeout / 1000;
+			_spec.it_value.tv_nsec = (_timeout % 1000) * 1000000L;
+			if (0 == _timeout){
+				_spec.it_value.tv_nsec = 1;	//! all zero would disarm
+			}
+
+			if (0 == timerfd_settime(fd_, 0, &_spec, nullptr)){
+				armed_ = _deadline;
+			}
+		}
+
+		void TimerFd::on_readable()
+		{
+			uint64_t _expirations = 0;
+			if (read(fd_, &_expirations, sizeof(_expirations)) < 0){
+				//! EAGAIN, someone else drained it
+			}
+
+			armed_ = INT64_MAX;
+			timer_.update();
+			arm();
+		}
+	}
+}
+#endif
+
+#endif
@@ -1,6 +1,16 @@
 #ifndef _TIMER_HANDLER_HEADER_
 #define _TIMER_HANDLER_HEADER_
 
+#include <stdint.h>
+#include <cstddef>
+#include <cstring>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <new>
+#include <type_traits>
+#include <utility>
+
 namespace gsf
 {
 	namespace utils
@@ -28,12 +38,212 @@ namespace gsf
 
 		}
 
-		template <typename T>
-		class TTimerHandler;
-
 		class TimerHandler;
 		typedef std::shared_ptr<TimerHandler> TimerHandlerPtr;
 
+		/**!
+			timer callback
+			move only, type erased callable that lives inside the TimerEvent.
+			callables up to inline_size bytes (a TTimerHandler binding an object and
+			a few arguments, most lambdas) are constructed in place, bigger ones fall
+			back to the heap. accepts TimerHandler subclasses, TimerHandlerPtr and
+			anything callable as f().
+		*/
+		class TimerCallback
+		{
+		public:
+			enum { inline_size = 48 };
+
+			TimerCallback();
+			TimerCallback(std::nullptr_t);
+
+			template <typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, TimerCallback>::value>::type>
+			TimerCallback(F &&f);
+
+			TimerCallback(TimerCallback &&other);
+			TimerCallback & operator = (TimerCallback &&other);
+			~TimerCallback();
+
+			TimerCallback(const TimerCallback &) = delete;
+			TimerCallback & operator = (const TimerCallback &) = delete;
+
+			void operator()();
+			explicit operator bool() const;
+
+			void reset();
+
+			//! the stored callable if it is an F, nullptr otherwise
+			template <typename F>
+			F * target();
+
+			template <typename F>
+			const F * target() const;
+
+		private:
+			struct Ops
+			{
+				void(*invoke)(void *p);
+				void(*move)(void *dst, void *src);	//! move constructs into dst and destroys src
+				void(*destroy)(void *p);
+			};
+
+			template <typename F, bool Inline>
+			struct TOps;
+
+			template <typename FT, typename F>
+			void construct_(F &&f, std::true_type);
+
+			template <typename FT, typename F>
+			void construct_(F &&f, std::false_type);
+
+			typedef std::aligned_storage<inline_size, alignof(std::max_align_t)>::type Storage;
+
+			Storage storage_;
+			const Ops *ops_;
+		};
+
+		template <typename F>
+		inline void timer_callback_call_(F &f, std::true_type)
+		{
+			f.F::handleTimeout();	//! qualified, the concrete type is known so skip the vtable
+		}
+
+		template <typename F>
+		inline void timer_callback_call_(F &f, std::false_type)
+		{
+			f();
+		}
+
+		template <typename H>
+		inline void timer_callback_call_(std::shared_ptr<H> &f, std::false_type)
+		{
+			f->handleTimeout();
+		}
+
+		template <typename F>
+		struct TimerCallback::TOps<F, true>
+		{
+			static void invoke(void *p) { timer_callback_call_(*static_cast<F*>(p), typename std::is_base_of<TimerHandler, F>::type()); }
+			static void move(void *dst, void *src) { new (dst) F(std::move(*static_cast<F*>(src))); static_cast<F*>(src)->~F(); }
+			static void destroy(void *p) { static_cast<F*>(p)->~F(); }
+			static const Ops table;
+		};
+
+		template <typename F>
+		struct TimerCallback::TOps<F, false>
+		{
+			static void invoke(void *p) { timer_callback_call_(**static_cast<F**>(p), typename std::is_base_of<TimerHandler, F>::type()); }
+			static void move(void *dst, void *src) { *static_cast<F**>(dst) = *static_cast<F**>(src); }
+			static void destroy(void *p) { delete *static_cast<F**>(p); }
+			static const Ops table;
+		};
+
+		template <typename F>
+		const TimerCallback::Ops TimerCallback::TOps<F, true>::table = { &invoke, &move, &destroy };
+
+		template <typename F>
+		const TimerCallback::Ops TimerCallback::TOps<F, false>::table = { &invoke, &move, &destroy };
+
+		inline TimerCallback::TimerCallback()
+			: ops_(nullptr)
+		{
+		}
+
+		inline TimerCallback::TimerCallback(std::nullptr_t)
+			: ops_(nullptr)
+		{
+		}
+
+		template <typename F, typename>
+		inline TimerCallback::TimerCallback(F &&f)
+		{
+			typedef typename std::decay<F>::type FT;
+			typedef std::integral_constant<bool, sizeof(FT) <= sizeof(Storage)
+				&& alignof(FT) <= alignof(Storage)
+				&& std::is_nothrow_move_constructible<FT>::value> Inline;
+
+			construct_<FT>(std::forward<F>(f), Inline());
+			ops_ = &TOps<FT, Inline::value>::table;
+		}
+
+		template <typename FT, typename F>
+		inline void TimerCallback::construct_(F &&f, std::true_type)
+		{
+			new (&storage_) FT(std::forward<F>(f));
+		}
+
+		template <typename FT, typename F>
+		inline void TimerCallback::construct_(F &&f, std::false_type)
+		{
+			*reinterpret_cast<FT**>(&storage_) = new FT(std::forward<F>(f));
+		}
+
+		inline TimerCallback::TimerCallback(TimerCallback &&other)
+			: ops_(other.ops_)
+		{
+			if (ops_) {
+				ops_->move(&storage_, &other.storage_);
+				other.ops_ = nullptr;
+			}
+		}
+
+		inline TimerCallback & TimerCallback::operator = (TimerCallback &&other)
+		{
+			if (this != &other) {
+				reset();
+				if (other.ops_) {
+					other.ops_->move(&storage_, &other.storage_);
+					ops_ = other.ops_;
+					other.ops_ = nullptr;
+				}
+			}
+			return *this;
+		}
+
+		inline TimerCallback::~TimerCallback()
+		{
+			reset();
+		}
+
+		inline void TimerCallback::operator()()
+		{
+			ops_->invoke(&storage_);
+		}
+
+		inline TimerCallback::operator bool() const
+		{
+			return ops_ != nullptr;
+		}
+
+		inline void TimerCallback::reset()
+		{
+			if (ops_) {
+				ops_->destroy(&storage_);
+				ops_ = nullptr;
+			}
+		}
+
+		template <typename F>
+		inline F * TimerCallback::target()
+		{
+			if (ops_ == &TOps<F, true>::table){
+				return reinterpret_cast<F*>(&storage_);
+			}
+			if (ops_ == &TOps<F, false>::table){
+				return *reinterpret_cast<F**>(&storage_);
+			}
+			return nullptr;
+		}
+
+		template <typename F>
+		inline const F * TimerCallback::target() const
+		{
+			return const_cast<TimerCallback*>(this)->target<F>();
+		}
+
+		template <typename T>
+		class TTimerHandler;
+
 		//R ()
 		template <typename R>
 		class TTimerHandler<R()>:public TimerHandler
@@ -47,9 +257,9 @@ namespace gsf
 		};
 
 		template <typename R>
-		inline TimerHandlerPtr makeTimerHandler(R(*func)())
+		inline TimerCallback makeTimerHandler(R(*func)())
 		{
-			return std::make_shared<TTimerHandler<R()>>(func);
+			return TimerCallback(TTimerHandler<R()>(func));
 		}
 
 		template <typename R>
@@ -78,9 +288,9 @@ namespace gsf
 		};
 
 		template <typename R, typename P1>
-		inline TimerHandlerPtr makeTimerHandler(R(*func)(P1), P1 p1)
+		inline TimerCallback makeTimerHandler(R(*func)(P1), P1 p1)
 		{
-			return std::make_shared<TTimerHandler<R(P1)>>(func, p1);
+			return TimerCallback(TTimerHandler<R(P1)>(func, p1));
 		}
 
 		template <typename R, typename P1>
@@ -111,9 +321,9 @@ namespace gsf
 		};
 
 		template <typename R, typename P1, typename P2>
-		inline TimerHandlerPtr makeTimerHandler(R(*func)(P1, P2), P1 p1, P2 p2)
+		inline TimerCallback makeTimerHandler(R(*func)(P1, P2), P1 p1, P2 p2)
 		{
-			return std::make_shared<TTimerHandler<R(P1, P2)>>(func, p1, p2);
+			return TimerCallback(TTimerHandler<R(P1, P2)>(func, p1, p2));
 		}
 
 		template <typename R, typename P1, typename P2>
@@ -146,9 +356,9 @@ namespace gsf
 		};
 
 		template <typename R, typename P1, typename P2, typename P3>
-		inline TimerHandlerPtr makeTimerHandler(R(*func)(P1, P2, P3), P1 p1, P2 p2, P3 p3)
+		inline TimerCallback makeTimerHandler(R(*func)(P1, P2, P3), P1 p1, P2 p2, P3 p3)
 		{
-			return std::make_shared<TTimerHandler<R(P1, P2, P3)>>(func, p1, p2, p3);
+			return TimerCallback(TTimerHandler<R(P1, P2, P3)>(func, p1, p2, p3));
 		}
 
 		template <typename R, typename P1, typename P2, typename P3>
@@ -183,9 +393,9 @@ namespace gsf
 		};
 
 		template <typename R, typename P1, typename P2, typename P3, typename P4>
-		inline TimerHandlerPtr makeTimerHandler(R(*func)(P1, P2, P3, P4), P1 p1, P2 p2, P3 p3, P4 p4)
+		inline TimerCallback makeTimerHandler(R(*func)(P1, P2, P3, P4), P1 p1, P2 p2, P3 p3, P4 p4)
 		{
-			return std::make_shared<TTimerHandler<R(P1, P2, P3, P4)>>(func, p1, p2, p3, p4);
+			return TimerCallback(TTimerHandler<R(P1, P2, P3, P4)>(func, p1, p2, p3, p4));
 		}
 
 		template <typename R, typename P1, typename P2, typename P3, typename P4>
@@ -222,9 +432,9 @@ namespace gsf
 		};
 
 		template <typename R, typename P1, typename P2, typename P3, typename P4, typename P5>
-		inline TimerHandlerPtr makeTimerHandler(R(*func)(P1, P2, P3, P4, P5), P1 p1, P2 p2, P3 p3, P4 p4, P5 p5)
+		inline TimerCallback makeTimerHandler(R(*func)(P1, P2, P3, P4, P5), P1 p1, P2 p2, P3 p3, P4 p4, P5 p5)
 		{
-			return std::make_shared<TTimerHandler<R(P1, P2, P3, P4, P5)>>(func, p1, p2, p3, p4, p5);
+			return TimerCallback(TTimerHandler<R(P1, P2, P3, P4, P5)>(func, p1, p2, p3, p4, p5));
 		}
 
 		template <typename R, typename P1, typename P2, typename P3, typename P4, typename P5>
@@ -263,9 +473,9 @@ namespace gsf
 		};
 
 		template <typename R, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6>
-		inline TimerHandlerPtr makeTimerHandler(R(*func)(P1, P2, P3, P4, P5, P6), P1 p1, P2 p2, P3 p3, P4 p4, P5 p5, P6 p6)
+		inline TimerCallback makeTimerHandler(R(*func)(P1, P2, P3, P4, P5, P6), P1 p1, P2 p2, P3 p3, P4 p4, P5 p5, P6 p6)
 		{
-			return std::make_shared<TTimerHandler<R(P1, P2, P3, P4, P5, P6)>>(func, p1, p2, p3, p4, p5, p6);
+			return TimerCallback(TTimerHandler<R(P1, P2, P3, P4, P5, P6)>(func, p1, p2, p3, p4, p5, p6));
 		}
 
 		template <typename R, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6>
@@ -306,9 +516,9 @@ namespace gsf
 		};
 
 		template <typename R, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename P7>
-		inline TimerHandlerPtr makeTimerHandler(R(*func)(P1, P2, P3, P4, P5, P6, P7), P1 p1, P2 p2, P3 p3, P4 p4, P5 p5, P6 p6, P7 p7)
+		inline TimerCallback makeTimerHandler(R(*func)(P1, P2, P3, P4, P5, P6, P7), P1 p1, P2 p2, P3 p3, P4 p4, P5 p5, P6 p6, P7 p7)
 		{
-			return std::make_shared<TTimerHandler<R(P1, P2, P3, P4, P5, P6, P7)>>(func, p1, p2, p3, p4, p5, p6, p7);
+			return TimerCallback(TTimerHandler<R(P1, P2, P3, P4, P5, P6, P7)>(func, p1, p2, p3, p4, p5, p6, p7));
 		}
 
 		template <typename R, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename P7>
@@ -351,9 +561,9 @@ namespace gsf
 		};
 
 		template <typename R, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename P7, typename P8>
-		inline TimerHandlerPtr makeTimerHandler(R(*func)(P1, P2, P3, P4, P5, P6, P7, P8), P1 p1, P2 p2, P3 p3, P4 p4, P5 p5, P6 p6, P7 p7, P8 p8)
+		inline TimerCallback makeTimerHandler(R(*func)(P1, P2, P3, P4, P5, P6, P7, P8), P1 p1, P2 p2, P3 p3, P4 p4, P5 p5, P6 p6, P7 p7, P8 p8)
 		{
-			return std::make_shared<TTimerHandler<R(P1, P2, P3, P4, P5, P6, P7, P8)>>(func, p1, p2, p3, p4, p5, p6, p7, p8);
+			return TimerCallback(TTimerHandler<R(P1, P2, P3, P4, P5, P6, P7, P8)>(func, p1, p2, p3, p4, p5, p6, p7, p8));
 		}
 
 		template <typename R, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename P7, typename P8>
@@ -398,9 +608,9 @@ namespace gsf
 		};
 
 		template <typename R, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename P7, typename P8, typename P9>
-		inline TimerHandlerPtr makeTimerHandler(R(*func)(P1, P2, P3, P4, P5, P6, P7, P8, P9), P1 p1, P2 p2, P3 p3, P4 p4, P5 p5, P6 p6, P7 p7, P8 p8, P9 p9)
+		inline TimerCallback makeTimerHandler(R(*func)(P1, P2, P3, P4, P5, P6, P7, P8, P9), P1 p1, P2 p2, P3 p3, P4 p4, P5 p5, P6 p6, P7 p7, P8 p8, P9 p9)
 		{
-			return std::make_shared<TTimerHandler<R(P1, P2, P3, P4, P5, P6, P7, P8, P9)>>(func, p1, p2, p3, p4, p5, p6, p7, p8, p9);
+			return TimerCallback(TTimerHandler<R(P1, P2, P3, P4, P5, P6, P7, P8, P9)>(func, p1, p2, p3, p4, p5, p6, p7, p8, p9));
 		}
 
 		template <typename R, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename P7, typename P8, typename P9>
@@ -438,9 +648,9 @@ namespace gsf
 		};
 
 		template <typename C, typename R>
-		inline TimerHandlerPtr makeTimerHandler(R(C::*func)(), C * obj)
+		inline TimerCallback makeTimerHandler(R(C::*func)(), C * obj)
 		{
-			return std::make_shared<TTimerHandler<R(C::*)()>>(func, obj);
+			return TimerCallback(TTimerHandler<R(C::*)()>(func, obj));
 		}
 
 		template <typename C, typename R>
@@ -471,9 +681,9 @@ namespace gsf
 		};
 
 		template <typename C, typename R, typename P1>
-		inline TimerHandlerPtr makeTimerHandler(R(C::*func)(P1), C * obj, P1 p1)
+		inline TimerCallback makeTimerHandler(R(C::*func)(P1), C * obj, P1 p1)
 		{
-			return std::make_shared<TTimerHandler<R(C::*)(P1)>>(func, obj, p1);
+			return TimerCallback(TTimerHandler<R(C::*)(P1)>(func, obj, p1));
 		}
 
 		template <typename C, typename R, typename P1>
@@ -506,9 +716,9 @@ namespace gsf
 		};
 
 		template <typename C, typename R, typename P1, typename P2>
-		inline TimerHandlerPtr makeTimerHandler(R(C::*func)(P1, P2), C * obj, P1 p1, P2 p2)
+		inline TimerCallback makeTimerHandler(R(C::*func)(P1, P2), C * obj, P1 p1, P2 p2)
 		{
-			return std::make_shared<TTimerHandler<R(C::*(P1, P2))>>(func, obj, p1, p2);
+			return TimerCallback(TTimerHandler<R(C::*(P1, P2))>(func, obj, p1, p2));
 		}
 
 		template <typename C, typename R, typename P1, typename P2>
@@ -543,9 +753,9 @@ namespace gsf
 		};
 
 		template <typename C, typename R, typename P1, typename P2, typename P3>
-		inline TimerHandlerPtr makeTimerHandler(R(C::*func)(P1, P2, P3), C * obj, P1 p1, P2 p2, P3 p3)
+		inline TimerCallback makeTimerHandler(R(C::*func)(P1, P2, P3), C * obj, P1 p1, P2 p2, P3 p3)
 		{
-			return std::make_shared<TTimerHandler<R(C::*)(P1, P2, P3)>>(func, obj, p1, p2, p3);
+			return TimerCallback(TTimerHandler<R(C::*)(P1, P2, P3)>(func, obj, p1, p2, p3));
 		}
 
 		template <typename C, typename R, typename P1, typename P2, typename P3>
@@ -582,9 +792,9 @@ namespace gsf
 		};
 
 		template <typename C, typename R, typename P1, typename P2, typename P3, typename P4>
-		inline TimerHandlerPtr makeTimerHandler(R(C::*func)(P1, P2, P3, P4), C * obj, P1 p1, P2 p2, P3 p3, P4 p4)
+		inline TimerCallback makeTimerHandler(R(C::*func)(P1, P2, P3, P4), C * obj, P1 p1, P2 p2, P3 p3, P4 p4)
 		{
-			return std::make_shared<TTimerHandler<R(C::*)(P1, P2, P3, P4)>>(func, obj, p1, p2, p3, p4);
+			return TimerCallback(TTimerHandler<R(C::*)(P1, P2, P3, P4)>(func, obj, p1, p2, p3, p4));
 		}
 
 		template <typename C, typename R, typename P1, typename P2, typename P3, typename P4>
@@ -623,9 +833,9 @@ namespace gsf
 		};
 
 		template <typename C, typename R, typename P1, typename P2, typename P3, typename P4, typename P5>
-		inline TimerHandlerPtr makeTimerHandler(R(C::*func)(P1, P2, P3, P4, P5), C * obj, P1 p1, P2 p2, P3 p3, P4 p4, P5 p5)
+		inline TimerCallback makeTimerHandler(R(C::*func)(P1, P2, P3, P4, P5), C * obj, P1 p1, P2 p2, P3 p3, P4 p4, P5 p5)
 		{
-			return std::make_shared<TTimerHandler<R(C::*)(P1, P2, P3, P4, P5)>>(func, obj, p1, p2, p3, p4, p5);
+			return TimerCallback(TTimerHandler<R(C::*)(P1, P2, P3, P4, P5)>(func, obj, p1, p2, p3, p4, p5));
 		}
 
 		template <typename C, typename R, typename P1, typename P2, typename P3, typename P4, typename P5>
@@ -666,9 +876,9 @@ namespace gsf
 		};
 
 		template <typename C, typename R, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6>
-		inline TimerHandlerPtr makeTimerHandler(R(C::*func)(P1, P2, P3, P4, P5, P6), C * obj, P1 p1, P2 p2, P3 p3, P4 p4, P5 p5, P6 p6)
+		inline TimerCallback makeTimerHandler(R(C::*func)(P1, P2, P3, P4, P5, P6), C * obj, P1 p1, P2 p2, P3 p3, P4 p4, P5 p5, P6 p6)
 		{
-			return std::make_shared<TTimerHandler<R(C::*)(P1, P2, P3, P4, P5, P6)>>(func, obj, p1, p2, p3, p4, p5, p6);
+			return TimerCallback(TTimerHandler<R(C::*)(P1, P2, P3, P4, P5, P6)>(func, obj, p1, p2, p3, p4, p5, p6));
 		}
 
 		template <typename C, typename R, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6>
@@ -711,9 +921,9 @@ namespace gsf
 		};
 
 		template <typename C, typename R, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename P7>
-		inline TimerHandlerPtr makeTimerHandler(R(C::*func)(P1, P2, P3, P4, P5, P6, P7), C * obj, P1 p1, P2 p2, P3 p3, P4 p4, P5 p5, P6 p6, P7 p7)
+		inline TimerCallback makeTimerHandler(R(C::*func)(P1, P2, P3, P4, P5, P6, P7), C * obj, P1 p1, P2 p2, P3 p3, P4 p4, P5 p5, P6 p6, P7 p7)
 		{
-			return std::make_shared<TTimerHandler<R(C::*)(P1, P2, P3, P4, P5, P6, P7)>>(func, obj, p1, p2, p3, p4, p5, p6, p7);
+			return TimerCallback(TTimerHandler<R(C::*)(P1, P2, P3, P4, P5, P6, P7)>(func, obj, p1, p2, p3, p4, p5, p6, p7));
 		}
 
 		template <typename C, typename R, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename P7>
@@ -758,9 +968,9 @@ namespace gsf
 		};
 
 		template <typename C, typename R, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename P7, typename P8>
-		inline TimerHandlerPtr makeTimerHandler(R(C::*func)(P1, P2, P3, P4, P5, P6, P7, P8), C * obj, P1 p1, P2 p2, P3 p3, P4 p4, P5 p5, P6 p6, P7 p7, P8 p8)
+		inline TimerCallback makeTimerHandler(R(C::*func)(P1, P2, P3, P4, P5, P6, P7, P8), C * obj, P1 p1, P2 p2, P3 p3, P4 p4, P5 p5, P6 p6, P7 p7, P8 p8)
 		{
-			return std::make_shared<TTimerHandler<R(C::*)(P1, P2, P3, P4, P5, P6, P7, P8)>>(func, obj, p1, p2, p3, p4, p5, p6, p7, p8);
+			return TimerCallback(TTimerHandler<R(C::*)(P1, P2, P3, P4, P5, P6, P7, P8)>(func, obj, p1, p2, p3, p4, p5, p6, p7, p8));
 		}
 
 		template <typename C, typename R, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename P7, typename P8>
@@ -807,9 +1017,9 @@ namespace gsf
 		};
 
 		template <typename C, typename R, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename P7, typename P8, typename P9>
-		inline TimerHandlerPtr makeTimerHandler(R(C::*func)(P1, P2, P3, P4, P5, P6, P7, P8, P9), C * obj, P1 p1, P2 p2, P3 p3, P4 p4, P5 p5, P6 p6, P7 p7, P8 p8, P9 p9)
+		inline TimerCallback makeTimerHandler(R(C::*func)(P1, P2, P3, P4, P5, P6, P7, P8, P9), C * obj, P1 p1, P2 p2, P3 p3, P4 p4, P5 p5, P6 p6, P7 p7, P8 p8, P9 p9)
 		{
-			return std::make_shared<TTimerHandler<R(C::*)(P1, P2, P3, P4, P5, P6, P7, P8, P9)>>(func, obj, p1, p2, p3, p4, p5, p6, p7, p8, p9);
+			return TimerCallback(TTimerHandler<R(C::*)(P1, P2, P3, P4, P5, P6, P7, P8, P9)>(func, obj, p1, p2, p3, p4, p5, p6, p7, p8, p9));
 		}
 
 		template <typename C, typename R, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename P7, typename P8, typename P9>
@@ -834,6 +1044,175 @@ namespace gsf
 			(m_obj->*m_func)(m_p1, m_p2, m_p3, m_p4, m_p5, m_p6, m_p7, m_p8, m_p9);
 		}
 
+		/**!
+			timer record
+			a callback that can be written to a snapshot (Timer::snapshot) and run
+			again by another process (Timer::restore). it holds a handler type id and
+			the handler's arguments as bytes, the type id is looked up in a process
+			wide registry when the timer fires. register every type at start up,
+			before arming or restoring timers that use it, with the same id in every
+			build that reads the snapshot.
+
+				void on_buff_expire(uint64_t entity, uint32_t buff) { ... }
+				registerTimerHandler(1, on_buff_expire);
+				timer.add_timer(delay_milliseconds(30000), makeTimerRecord(1, on_buff_expire, entity, buff));
+
+			arguments are copied byte for byte, so they must be trivially copyable
+			(ids, not pointers). a handler registered as TimerRecordFunc takes the
+			bytes as they are, build its callback as TimerRecord(type, data, size).
+			makeTimerRecord gives an empty callback, which add_timer refuses with id 0,
+			if the type id has no handler or another one. a restored record whose type
+			isn't registered, or whose arguments don't match its size, fires as a no-op.
+		*/
+		enum
+		{
+			TIMER_RECORD_TYPES = 4096,	//! type ids 1..4095
+		};
+
+		typedef void(*TimerRecordFunc)(const char *data, uint32_t size);
+
+		class TimerRecord
+		{
+		public:
+			TimerRecord(uint32_t type, const char *data, uint32_t size)
+				: type_(type)
+				, args_(data, size)
+			{}
+
+			uint32_t type() const { return type_; }
+			const char * data() const { return args_.data(); }
+			uint32_t size() const { return static_cast<uint32_t>(args_.size()); }
+
+			void operator()();
+
+		private:
+			uint32_t type_;
+			std::string args_;
+		};
+
+		struct timer_record_type
+		{
+			void(*invoke)(void(*func)(), const char *data, uint32_t size);
+			void(*func)();
+		};
+
+		inline std::atomic<const timer_record_type*> * timer_record_types()
+		{
+			static std::atomic<const timer_record_type*> _types[TIMER_RECORD_TYPES] = {};
+			return _types;
+		}
+
+		//! arguments are unpacked front to back, each one copied out of the byte string
+		template <typename... P>
+		struct timer_record_unpack_;
+
+		template <>
+		struct timer_record_unpack_<>
+		{
+			enum { size = 0 };
+
+			template <typename F, typename... A>
+			static void call(F func, const char *, A... a) { func(a...); }
+
+			static void pack(char *) {}
+		};
+
+		template <typename P1, typename... P>
+		struct timer_record_unpack_<P1, P...>
+		{
+			typedef typename std::decay<P1>::type type;
+			static_assert(std::is_trivially_copyable<type>::value, "timer record arguments must be trivially copyable");
+
+			enum { size = sizeof(type) + timer_record_unpack_<P...>::size };
+
+			template <typename F, typename... A>
+			static void call(F func, const char *data, A... a)
+			{
+				type _v;
+				memcpy(&_v, data, sizeof(_v));
+				timer_record_unpack_<P...>::call(func, data + sizeof(_v), a..., _v);
+			}
+
+			template <typename T1, typename... T>
+			static void pack(char *data, const T1 &p1, const T &... p)
+			{
+				type _v(p1);
+				memcpy(data, &_v, sizeof(_v));
+				timer_record_unpack_<P...>::pack(data + sizeof(_v), p...);
+			}
+		};
+
+		//! func is cast back to the exact type it was registered with, a result is discarded
+		template <typename R, typename... P>
+		inline void timer_record_invoke_(void(*func)(), const char *data, uint32_t size)
+		{
+			if (size == timer_record_unpack_<P...>::size){
+				timer_record_unpack_<P...>::call(reinterpret_cast<R(*)(P...)>(func), data);
+			}
+		}
+
+		inline void timer_record_invoke_raw_(void(*func)(), const char *data, uint32_t size)
+		{
+			reinterpret_cast<TimerRecordFunc>(func)(data, size);
+		}
+
+		inline int timer_record_register_(uint32_t type, const timer_record_type &entry)
+		{
+			if (type == 0 || type >= TIMER_RECORD_TYPES){
+				return -1;
+			}
+			//! entries live as long as the process, a record may be firing with the old one
+			timer_record_types()[type].store(new timer_record_type(entry), std::memory_order_release);
+			return 0;
+		}
+
+		//! 0 succ, -1 if type is out of range. a handler taking the raw argument bytes
+		inline int registerTimerHandler(uint32_t type, TimerRecordFunc func)
+		{
+			timer_record_type _entry = { &timer_record_invoke_raw_, reinterpret_cast<void(*)()>(func) };
+			return timer_record_register_(type, _entry);
+		}
+
+		//! a handler taking its arguments unpacked, makeTimerRecord(type, p...) must pass the same types
+		template <typename R, typename... P>
+		inline int registerTimerHandler(uint32_t type, R(*func)(P...))
+		{
+			timer_record_type _entry = { &timer_record_invoke_<R, P...>, reinterpret_cast<void(*)()>(func) };
+			return timer_record_register_(type, _entry);
+		}
+
+		inline const timer_record_type * timer_record_find(uint32_t type)
+		{
+			return type < TIMER_RECORD_TYPES ? timer_record_types()[type].load(std::memory_order_acquire) : nullptr;
+		}
+
+		inline void TimerRecord::operator()()
+		{
+			const timer_record_type *_entry = timer_record_find(type_);
+			if (_entry){
+				_entry->invoke(_entry->func, args_.data(), static_cast<uint32_t>(args_.size()));
+			}
+		}
+
+		/**!
+			the arguments are converted to func's parameters. if func isn't the handler
+			registered under type the callback is empty and add_timer returns 0, so a
+			wrong type id shows at once and restore can never run a handler with
+			another one's arguments.
+		*/
+		template <typename R, typename... P, typename... A>
+		inline TimerCallback makeTimerRecord(uint32_t type, R(*func)(P...), const A &... a)
+		{
+			static_assert(sizeof...(P) == sizeof...(A), "wrong number of timer record arguments");
+			const timer_record_type *_entry = timer_record_find(type);
+			if (!_entry || _entry->invoke != &timer_record_invoke_<R, P...> || _entry->func != reinterpret_cast<void(*)()>(func)){
+				return TimerCallback();
+			}
+			char _data[timer_record_unpack_<P...>::size + 1];
+			timer_record_unpack_<P...>::pack(_data, a...);
+			return TimerCallback(TimerRecord(type, _data, timer_record_unpack_<P...>::size));
+		}
+
 	}
 }
 
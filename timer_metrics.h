@@ -0,0 +1,131 @@
+#ifndef _TIMER_METRICS_HEADER_
+#define _TIMER_METRICS_HEADER_
+
+#include <stdint.h>
+#include <string.h>
+
+namespace gsf
+{
+	namespace utils
+	{
+		/**!
+			histogram
+			log-linear buckets as in HdrHistogram: values below 16 are exact, above
+			that every power of 2 is split into 16 buckets, so a recorded value is
+			known within 1/16 of itself over the whole uint64_t range.
+			recording is a bit scan and an increment.
+		*/
+
+		enum
+		{
+			TIMER_HISTOGRAM_SUB_BITS = 4,
+			TIMER_HISTOGRAM_SUB = 1 << TIMER_HISTOGRAM_SUB_BITS,
+			TIMER_HISTOGRAM_BUCKETS = (64 - TIMER_HISTOGRAM_SUB_BITS + 1) * TIMER_HISTOGRAM_SUB,
+		};
+
+		struct timer_histogram
+		{
+			uint64_t counts[TIMER_HISTOGRAM_BUCKETS];
+			uint64_t count;
+			uint64_t sum;
+			uint64_t max;
+		};
+
+		/**!
+			Timer counters, see Timer::metrics (built with GSF_TIMER_METRICS).
+			totals since the Timer was created or reset_metrics, rates are the
+			difference of two snapshots over the difference of their now.
+		*/
+		struct timer_metrics
+		{
+			int64_t now;			//! clock source tick of the snapshot
+			uint64_t updates;		//! update() calls
+			uint64_t added;			//! timers armed, from any thread
+			uint64_t cancelled;		//! rmv_timer calls that succeeded
+			uint64_t fired;			//! callbacks run
+			uint64_t pending;		//! queue entries (a coalescing bucket counts once, tombstones count)
+			uint64_t peak_pending;
+
+			timer_histogram lateness;			//! now - deadline at firing, in clock source ticks (ms)
+			timer_histogram fired_per_update;	//! callbacks run by one update()
+			timer_histogram callback_ns;		//! time spent in one callback, not recorded for callbacks run on a TimerPool
+		};
+
+		inline void	     timer_histogram_reset(timer_histogram* h);
+
+		inline void	     timer_histogram_record(timer_histogram* h, uint64_t v);
+
+		//! highest value equivalent to the p-th percentile (0..100), 0 if empty
+		inline uint64_t	 timer_histogram_percentile(const timer_histogram* h, double p);
+
+		inline uint32_t	 timer_histogram_index_(uint64_t v);
+
+		inline uint64_t	 timer_histogram_upper_(uint32_t index);
+
+		void timer_histogram_reset(timer_histogram* h)
+		{
+			memset(h, 0, sizeof(*h));
+		}
+
+		uint32_t timer_histogram_index_(uint64_t v)
+		{
+			if (v < TIMER_HISTOGRAM_SUB)
+				return static_cast<uint32_t>(v);
+
+#if defined(__GNUC__)
+			uint32_t msb = 63 - __builtin_clzll(v);
+#else
+			uint32_t msb = 0;
+			for (uint64_t x = v; x >>= 1;)
+				++msb;
+#endif
+			uint32_t shift = msb - TIMER_HISTOGRAM_SUB_BITS;
+			return ((shift + 1) << TIMER_HISTOGRAM_SUB_BITS) + static_cast<uint32_t>(v >> shift) - TIMER_HISTOGRAM_SUB;
+		}
+
+		uint64_t timer_histogram_upper_(uint32_t index)
+		{
+			if (index < TIMER_HISTOGRAM_SUB)
+				return index;
+
+			uint32_t shift = (index >> TIMER_HISTOGRAM_SUB_BITS) - 1;
+			uint64_t lower = uint64_t((index & (TIMER_HISTOGRAM_SUB - 1)) + TIMER_HISTOGRAM_SUB) << shift;
+			return lower + ((uint64_t(1) << shift) - 1);
+		}
+
+		void timer_histogram_record(timer_histogram* h, uint64_t v)
+		{
+			++h->counts[timer_histogram_index_(v)];
+			++h->count;
+			h->sum += v;
+			if (v > h->max)
+				h->max = v;
+		}
+
+		uint64_t timer_histogram_percentile(const timer_histogram* h, double p)
+		{
+			if (!h->count)
+				return 0;
+
+			uint64_t rank = static_cast<uint64_t>(p / 100.0 * h->count + 0.5);
+			if (rank < 1)
+				rank = 1;
+			if (rank > h->count)
+				rank = h->count;
+
+			uint64_t seen = 0;
+			for (uint32_t i = 0; i < TIMER_HISTOGRAM_BUCKETS; ++i)
+			{
+				seen += h->counts[i];
+				if (seen >= rank)
+				{
+					uint64_t upper = timer_histogram_upper_(i);
+					return upper < h->max ? upper : h->max;
+				}
+			}
+			return h->max;
+		}
+	}
+}
+
+#endif
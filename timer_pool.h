@@ -0,0 +1,221 @@
+#ifndef _TIMER_POOL_HEADER_
+#define _TIMER_POOL_HEADER_
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gsf
+{
+	namespace utils
+	{
+		/**!
+			callback pool
+			worker threads for Timer::use_pool. a task without a key goes to the next
+			worker round robin and idle workers steal it (owners take the oldest,
+			thieves the newest). a task with a key is pinned to worker key % size and
+			runs after every earlier task with that key, in submission order.
+		*/
+		struct timer_task
+		{
+			void(*fn)(void *ctx, void *arg);
+			void *ctx;
+			void *arg;
+		};
+
+		class TimerPool
+		{
+		public:
+			explicit TimerPool(unsigned threads = std::thread::hardware_concurrency());
+
+			//! runs what is still queued, then joins the workers
+			~TimerPool();
+
+			unsigned size() const { return static_cast<unsigned>(workers_.size()); }
+
+			void submit(const timer_task &task, uint64_t key);
+
+			//! steal one unkeyed task and run it on the calling thread, false if there was none
+			bool run_one();
+
+		private:
+			TimerPool(const TimerPool &);
+			TimerPool & operator = (const TimerPool &);
+
+			struct worker
+			{
+				std::mutex lock;
+				std::deque<timer_task> pinned;	//! keyed, only this worker runs them
+				std::deque<timer_task> tasks;	//! unkeyed, stealable
+				std::atomic<uint32_t> pinned_n;
+				std::thread thread;
+			};
+
+			bool take(worker &w, timer_task &task);
+			bool steal(unsigned from, timer_task &task);
+			void run(unsigned index);
+			void wake();
+
+			std::vector<std::unique_ptr<worker>> workers_;
+			std::atomic<uint32_t> next_;
+			std::atomic<uint32_t> stealable_;	//! unkeyed tasks queued on any worker
+
+			std::mutex sleep_lock_;
+			std::condition_variable sleep_cv_;
+			std::atomic<uint32_t> sleepers_;
+			bool stop_;
+		};
+
+		TimerPool::TimerPool(unsigned threads)
+			: next_(0)
+			, stealable_(0)
+			, sleepers_(0)
+			, stop_(false)
+		{
+			if (threads == 0){
+				threads = 1;
+			}
+
+			for (unsigned i = 0; i < threads; ++i)
+			{
+				workers_.emplace_back(new worker());
+				workers_.back()->pinned_n.store(0, std::memory_order_relaxed);
+			}
+			for (unsigned i = 0; i < threads; ++i)
+			{
+				workers_[i]->thread = std::thread(&TimerPool::run, this, i);
+			}
+		}
+
+		TimerPool::~TimerPool()
+		{
+			{
+				std::lock_guard<std::mutex> _guard(sleep_lock_);
+				stop_ = true;
+			}
+			sleep_cv_.notify_all();
+
+			for (size_t i = 0; i < workers_.size(); ++i)
+			{
+				workers_[i]->thread.join();
+			}
+		}
+
+		void TimerPool::submit(const timer_task &task, uint64_t key)
+		{
+			if (key)
+			{
+				worker &_w = *workers_[key % workers_.size()];
+				std::lock_guard<std::mutex> _guard(_w.lock);
+				_w.pinned.push_back(task);
+				_w.pinned_n.fetch_add(1, std::memory_order_seq_cst);
+			}
+			else
+			{
+				worker &_w = *workers_[next_.fetch_add(1, std::memory_order_relaxed) % workers_.size()];
+				std::lock_guard<std::mutex> _guard(_w.lock);
+				_w.tasks.push_back(task);
+				stealable_.fetch_add(1, std::memory_order_seq_cst);
+			}
+			wake();
+		}
+
+		void TimerPool::wake()
+		{
+			//! store / load against run(): submit raises a counter then reads sleepers_, a worker
+			//! raises sleepers_ then reads the counters, all seq_cst, so at least one side sees the
+			//! other. taking sleep_lock_ waits out a worker between its re-check and wait()
+			if (sleepers_.load(std::memory_order_seq_cst))
+			{
+				{
+					std::lock_guard<std::mutex> _guard(sleep_lock_);
+				}
+				sleep_cv_.notify_all();
+			}
+		}
+
+		bool TimerPool::take(worker &w, timer_task &task)
+		{
+			std::lock_guard<std::mutex> _guard(w.lock);
+			if (!w.pinned.empty())
+			{
+				task = w.pinned.front();
+				w.pinned.pop_front();
+				w.pinned_n.fetch_sub(1, std::memory_order_relaxed);
+				return true;
+			}
+			if (!w.tasks.empty())
+			{
+				task = w.tasks.front();
+				w.tasks.pop_front();
+				stealable_.fetch_sub(1, std::memory_order_relaxed);
+				return true;
+			}
+			return false;
+		}
+
+		bool TimerPool::steal(unsigned from, timer_task &task)
+		{
+			if (!stealable_.load(std::memory_order_acquire)){
+				return false;
+			}
+
+			for (size_t i = 1; i <= workers_.size(); ++i)
+			{
+				worker &_w = *workers_[(from + i) % workers_.size()];
+				std::lock_guard<std::mutex> _guard(_w.lock);
+				if (!_w.tasks.empty())
+				{
+					task = _w.tasks.back();
+					_w.tasks.pop_back();
+					stealable_.fetch_sub(1, std::memory_order_relaxed);
+					return true;
+				}
+			}
+			return false;
+		}
+
+		bool TimerPool::run_one()
+		{
+			timer_task _task;
+			if (!steal(next_.load(std::memory_order_relaxed), _task)){
+				return false;
+			}
+			_task.fn(_task.ctx, _task.arg);
+			return true;
+		}
+
+		void TimerPool::run(unsigned index)
+		{
+			worker &_self = *workers_[index];
+			timer_task _task;
+			for (;;)
+			{
+				if (take(_self, _task) || steal(index, _task))
+				{
+					_task.fn(_task.ctx, _task.arg);
+					continue;
+				}
+
+				std::unique_lock<std::mutex> _guard(sleep_lock_);
+				sleepers_.fetch_add(1, std::memory_order_seq_cst);
+				while (!stop_ && !stealable_.load(std::memory_order_seq_cst) && !_self.pinned_n.load(std::memory_order_seq_cst))
+				{
+					sleep_cv_.wait(_guard);
+				}
+				sleepers_.fetch_sub(1, std::memory_order_relaxed);
+
+				if (stop_ && !stealable_.load(std::memory_order_acquire) && !_self.pinned_n.load(std::memory_order_acquire)){
+					return;
+				}
+			}
+		}
+	}
+}
+
+#endif
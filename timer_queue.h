@@ -0,0 +1,212 @@
+#ifndef _TIMER_QUEUE_HEADER_
+#define _TIMER_QUEUE_HEADER_
+
+#include <stdint.h>
+
+#include "min_heap.h"
+#include "dary_heap.h"
+#include "radix_heap.h"
+#include "timing_wheel.h"
+
+namespace gsf
+{
+	namespace utils
+	{
+		/**!
+			timer queue
+			the pending queue of Timer / BasicTimer is a policy class template
+			Queue<T> over the event type, every policy wraps one of the C style
+			structures behind the same members:
+
+				static void elem_init(T* e)		before e is queued for the first time
+				void rebase(int64_t now)		clock (re)set, only the wheel cares
+				unsigned size()
+				int push(T* e)					0 succ, -1 out of memory
+				int erase(T* e)					0 succ, -1 if e isn't queued
+				int adjust(T* e)				tp_ changed, -1 if e isn't queued
+				T* top(int64_t now)				earliest element due before now, stays queued
+				T* pop()						remove what top returned
+				int64_t next_deadline()			INT64_MAX if empty
+				int reserve(unsigned n)			room for n elements in total
+				void append(T* e)				after reserve, unordered until heapify
+				void heapify(unsigned from)		restore order over the appended tail
+				unsigned sweep(F fn)			drop what fn returns nonzero for
+				unsigned count_below(int64_t key, F fn)
+				lazy_cancel						nonzero if leaving tombstones queued pays off
+
+			GSF_TIMER_QUEUE names the policy Timer uses and the BasicTimer default.
+			it follows the GSF_TIMER_USE_* switches unless defined before timer.h
+			is included, e.g. -DGSF_TIMER_QUEUE=my_queue with my_queue declared
+			ahead of it.
+		*/
+
+		template <typename T>
+		class min_heap_queue
+		{
+		public:
+			enum { lazy_cancel = 1 };
+
+			min_heap_queue() { min_heap_ctor(&s_); }
+			~min_heap_queue() { min_heap_dtor(&s_); }
+
+			static void elem_init(T* e) { min_heap_elem_init(e); }
+			void rebase(int64_t) {}
+			unsigned size() { return min_heap_size(&s_); }
+
+			int push(T* e) { return min_heap_push(&s_, e); }
+			int erase(T* e) { return min_heap_erase(&s_, e); }
+			int adjust(T* e) { return min_heap_adjust(&s_, e); }
+
+			T* top(int64_t now) { T* e = min_heap_top(&s_); return e && e->tp_ < now ? e : 0; }
+			T* pop() { return min_heap_pop(&s_); }
+			int64_t next_deadline() { return min_heap_empty(&s_) ? INT64_MAX : min_heap_top(&s_)->tp_; }
+
+			int reserve(unsigned n) { return min_heap_reserve(&s_, n); }
+			void append(T* e) { min_heap_append(&s_, e); }
+			void heapify(unsigned from) { min_heap_heapify(&s_, from); }
+
+			template <typename F>
+			unsigned sweep(F fn) { return min_heap_sweep(&s_, fn); }
+
+			template <typename F>
+			unsigned count_below(int64_t key, F fn) { return min_heap_count_below(&s_, key, fn); }
+
+		private:
+			min_heap_queue(const min_heap_queue &);
+			min_heap_queue & operator = (const min_heap_queue &);
+
+			min_heap<T> s_;
+		};
+
+		template <typename T>
+		class dary_heap_queue
+		{
+		public:
+			enum { lazy_cancel = 1 };
+
+			dary_heap_queue() { dary_heap_ctor(&s_); }
+			~dary_heap_queue() { dary_heap_dtor(&s_); }
+
+			static void elem_init(T* e) { dary_heap_elem_init(e); }
+			void rebase(int64_t) {}
+			unsigned size() { return dary_heap_size(&s_); }
+
+			int push(T* e) { return dary_heap_push(&s_, e); }
+			int erase(T* e) { return dary_heap_erase(&s_, e); }
+			int adjust(T* e) { return dary_heap_adjust(&s_, e); }
+
+			T* top(int64_t now) { T* e = dary_heap_top(&s_); return e && e->tp_ < now ? e : 0; }
+			T* pop() { return dary_heap_pop(&s_); }
+			int64_t next_deadline() { return dary_heap_empty(&s_) ? INT64_MAX : dary_heap_top(&s_)->tp_; }
+
+			int reserve(unsigned n) { return dary_heap_reserve(&s_, n); }
+			void append(T* e) { dary_heap_append(&s_, e); }
+			void heapify(unsigned from) { dary_heap_heapify(&s_, from); }
+
+			template <typename F>
+			unsigned sweep(F fn) { return dary_heap_sweep(&s_, fn); }
+
+			template <typename F>
+			unsigned count_below(int64_t key, F fn) { return dary_heap_count_below(&s_, key, fn); }
+
+		private:
+			dary_heap_queue(const dary_heap_queue &);
+			dary_heap_queue & operator = (const dary_heap_queue &);
+
+			dary_heap<T> s_;
+		};
+
+		template <typename T>
+		class radix_heap_queue
+		{
+		public:
+			enum { lazy_cancel = 1 };
+
+			radix_heap_queue() { radix_heap_ctor(&s_); }
+			~radix_heap_queue() { radix_heap_dtor(&s_); }
+
+			static void elem_init(T* e) { radix_heap_elem_init(e); }
+			void rebase(int64_t) {}
+			unsigned size() { return radix_heap_size(&s_); }
+
+			int push(T* e) { return radix_heap_push(&s_, e); }
+			int erase(T* e) { return radix_heap_erase(&s_, e); }
+			int adjust(T* e) { return radix_heap_adjust(&s_, e); }
+
+			T* top(int64_t now) { return radix_heap_top(&s_, now); }
+			T* pop() { return radix_heap_pop(&s_); }
+			int64_t next_deadline() { return radix_heap_min(&s_); }
+
+			int reserve(unsigned n) { return radix_heap_reserve(&s_, n); }
+			void append(T* e) { radix_heap_append(&s_, e); }
+			void heapify(unsigned from) { radix_heap_heapify(&s_, from); }
+
+			template <typename F>
+			unsigned sweep(F fn) { return radix_heap_sweep(&s_, fn); }
+
+			template <typename F>
+			unsigned count_below(int64_t key, F fn) { return radix_heap_count_below(&s_, key, fn); }
+
+		private:
+			radix_heap_queue(const radix_heap_queue &);
+			radix_heap_queue & operator = (const radix_heap_queue &);
+
+			radix_heap<T> s_;
+		};
+
+		//! erase is O(1) already, cancelled timers leave at once and sweep has nothing to do
+		template <typename T>
+		class timing_wheel_queue
+		{
+		public:
+			enum { lazy_cancel = 0 };
+
+			timing_wheel_queue() { timing_wheel_ctor(&w_, 0); }
+			~timing_wheel_queue() { timing_wheel_dtor(&w_); }
+
+			static void elem_init(T* e) { timing_wheel_elem_init(e); }
+
+			//! the wheel turns from its current tick, it can only be moved while empty
+			void rebase(int64_t now) { if (timing_wheel_empty(&w_)) timing_wheel_ctor(&w_, now); }
+			unsigned size() { return timing_wheel_size(&w_); }
+
+			int push(T* e) { return timing_wheel_push(&w_, e); }
+			int erase(T* e) { return timing_wheel_erase(&w_, e); }
+			int adjust(T* e) { return timing_wheel_erase(&w_, e) ? -1 : timing_wheel_push(&w_, e); }
+
+			T* top(int64_t now) { return timing_wheel_top(&w_, now); }
+			T* pop() { return timing_wheel_pop(&w_); }
+			int64_t next_deadline() { return timing_wheel_next_tick(&w_); }
+
+			int reserve(unsigned) { return 0; }
+			void append(T* e) { timing_wheel_push(&w_, e); }
+			void heapify(unsigned) {}
+
+			template <typename F>
+			unsigned sweep(F) { return 0; }
+
+			template <typename F>
+			unsigned count_below(int64_t key, F fn) { return timing_wheel_count_below(&w_, key, fn); }
+
+		private:
+			timing_wheel_queue(const timing_wheel_queue &);
+			timing_wheel_queue & operator = (const timing_wheel_queue &);
+
+			timing_wheel<T> w_;
+		};
+	}
+}
+
+#if !defined(GSF_TIMER_QUEUE)
+#if defined(GSF_TIMER_USE_TIMING_WHEEL)
+#define GSF_TIMER_QUEUE gsf::utils::timing_wheel_queue
+#elif defined(GSF_TIMER_USE_DARY_HEAP)
+#define GSF_TIMER_QUEUE gsf::utils::dary_heap_queue
+#elif defined(GSF_TIMER_USE_RADIX_HEAP)
+#define GSF_TIMER_QUEUE gsf::utils::radix_heap_queue
+#else
+#define GSF_TIMER_QUEUE gsf::utils::min_heap_queue
+#endif
+#endif
+
+#endif
@@ -0,0 +1,194 @@
+#ifndef _TIMER_SNAPSHOT_HEADER_
+#define _TIMER_SNAPSHOT_HEADER_
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+
+#include "timer_calendar.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace gsf
+{
+	namespace utils
+	{
+		/**!
+			timer snapshot
+			file written by Timer::snapshot and read back by Timer::restore: a header,
+			then one 8 byte aligned entry per pending TimerRecord. deadlines are kept
+			relative to the system clock at the time of the snapshot, so they survive
+			a restart whatever the clock source. the file is written to path.tmp
+			through a shared mapping and renamed over path once synced, a crash never
+			leaves a torn snapshot behind.
+		*/
+
+		enum
+		{
+			TIMER_SNAPSHOT_MAGIC = 0x534d5447,	//! "GTMS"
+			TIMER_SNAPSHOT_VERSION = 1,
+
+			TIMER_SNAPSHOT_CALENDAR = 1,		//! a calendar_schedule follows the entry
+		};
+
+		struct timer_snapshot_header
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint64_t count;
+			uint64_t bytes;		//! file size
+			int64_t wall;		//! system clock (ms) the deadlines are relative to
+		};
+
+		struct timer_snapshot_entry
+		{
+			int64_t due;		//! deadline - header wall, negative if it was already due
+			int64_t period;		//! delay_repeat period, 0 for one-shot and calendar timers
+			uint64_t key;		//! order key, see Timer::set_order_key
+			uint32_t type;		//! TimerRecord type id
+			uint32_t size;		//! argument bytes after the entry (and its schedule)
+			uint32_t slack;
+			uint32_t flags;
+		};
+
+		struct timer_snapshot_file
+		{
+			char *p;
+			uint64_t size;
+			int fd;
+		};
+
+		inline uint64_t	 timer_snapshot_entry_size(uint32_t size, bool calendar);
+
+		//! map path.tmp for writing, size bytes
+		inline int		 timer_snapshot_create(timer_snapshot_file *f, const char *path, uint64_t size);
+
+		//! sync path.tmp and move it over path, unmaps in any case
+		inline int		 timer_snapshot_commit(timer_snapshot_file *f, const char *path);
+
+		//! map path for reading, -1 unless every entry lies within the file
+		inline int		 timer_snapshot_open(timer_snapshot_file *f, const char *path);
+
+		inline void		 timer_snapshot_close(timer_snapshot_file *f);
+
+		uint64_t timer_snapshot_entry_size(uint32_t size, bool calendar)
+		{
+			uint64_t _size = sizeof(timer_snapshot_entry) + (calendar ? sizeof(calendar_schedule) : 0) + size;
+			return (_size + 7) & ~uint64_t(7);
+		}
+
+#if defined(__unix__) || defined(__APPLE__)
+		int timer_snapshot_create(timer_snapshot_file *f, const char *path, uint64_t size)
+		{
+			std::string _tmp = std::string(path) + ".tmp";
+			f->p = nullptr;
+			f->size = size;
+			f->fd = open(_tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+			if (f->fd < 0){
+				return -1;
+			}
+
+			if (ftruncate(f->fd, static_cast<off_t>(size)) == 0)
+			{
+				void *_p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, f->fd, 0);
+				if (_p != MAP_FAILED)
+				{
+					f->p = static_cast<char*>(_p);
+					return 0;
+				}
+			}
+
+			close(f->fd);
+			unlink(_tmp.c_str());
+			return -1;
+		}
+
+		int timer_snapshot_commit(timer_snapshot_file *f, const char *path)
+		{
+			std::string _tmp = std::string(path) + ".tmp";
+			int _ret = msync(f->p, f->size, MS_SYNC);
+			munmap(f->p, f->size);
+			if (fsync(f->fd) != 0){
+				_ret = -1;
+			}
+			close(f->fd);
+
+			if (_ret == 0 && rename(_tmp.c_str(), path) == 0){
+				return 0;
+			}
+			unlink(_tmp.c_str());
+			return -1;
+		}
+
+		int timer_snapshot_open(timer_snapshot_file *f, const char *path)
+		{
+			f->p = nullptr;
+			f->fd = open(path, O_RDONLY);
+			if (f->fd < 0){
+				return -1;
+			}
+
+			struct stat _st;
+			if (fstat(f->fd, &_st) != 0 || static_cast<uint64_t>(_st.st_size) < sizeof(timer_snapshot_header))
+			{
+				close(f->fd);
+				return -1;
+			}
+
+			f->size = static_cast<uint64_t>(_st.st_size);
+			void *_p = mmap(nullptr, f->size, PROT_READ, MAP_PRIVATE, f->fd, 0);
+			if (_p == MAP_FAILED)
+			{
+				close(f->fd);
+				return -1;
+			}
+			f->p = static_cast<char*>(_p);
+			madvise(f->p, f->size, MADV_SEQUENTIAL);
+
+			const timer_snapshot_header *_header = reinterpret_cast<const timer_snapshot_header*>(f->p);
+			bool _valid = _header->magic == TIMER_SNAPSHOT_MAGIC && _header->version == TIMER_SNAPSHOT_VERSION && _header->bytes == f->size;
+
+			uint64_t _offset = sizeof(timer_snapshot_header);
+			for (uint64_t i = 0; _valid && i < _header->count; ++i)
+			{
+				if (f->size - _offset < sizeof(timer_snapshot_entry))
+				{
+					_valid = false;
+					break;
+				}
+				const timer_snapshot_entry *_entry = reinterpret_cast<const timer_snapshot_entry*>(f->p + _offset);
+				uint64_t _size = timer_snapshot_entry_size(_entry->size, (_entry->flags & TIMER_SNAPSHOT_CALENDAR) != 0);
+				if (f->size - _offset < _size){
+					_valid = false;
+				}
+				_offset += _size;
+			}
+
+			if (!_valid)
+			{
+				timer_snapshot_close(f);
+				return -1;
+			}
+			return 0;
+		}
+
+		void timer_snapshot_close(timer_snapshot_file *f)
+		{
+			munmap(f->p, f->size);
+			close(f->fd);
+		}
+#else
+		int timer_snapshot_create(timer_snapshot_file *, const char *, uint64_t) { return -1; }
+		int timer_snapshot_commit(timer_snapshot_file *, const char *) { return -1; }
+		int timer_snapshot_open(timer_snapshot_file *, const char *) { return -1; }
+		void timer_snapshot_close(timer_snapshot_file *) {}
+#endif
+	}
+}
+
+#endif
@@ -0,0 +1,378 @@
+#ifndef _TIMING_WHEEL_HEADER_
+#define _TIMING_WHEEL_HEADER_
+
+#include <stdint.h>
+
+namespace gsf
+{
+	namespace utils
+	{
+		/**!
+			hierarchical timing wheel
+			level 0 has 256 one-millisecond slots, levels 1..4 have 64 slots each,
+			together they cover 2^32 ms (~49 days). farther elements park in the
+			last level and are re-placed every time that level cascades.
+			every slot is a circular doubly linked list threaded through the
+			elements (list_prev / list_next / list_slot), so push and erase are O(1).
+		*/
+
+		enum
+		{
+			TIMING_WHEEL_ROOT_BITS = 8,
+			TIMING_WHEEL_LEVEL_BITS = 6,
+			TIMING_WHEEL_LEVELS = 4,
+			TIMING_WHEEL_ROOT_SIZE = 1 << TIMING_WHEEL_ROOT_BITS,
+			TIMING_WHEEL_LEVEL_SIZE = 1 << TIMING_WHEEL_LEVEL_BITS,
+			TIMING_WHEEL_READY = TIMING_WHEEL_ROOT_SIZE + TIMING_WHEEL_LEVELS * TIMING_WHEEL_LEVEL_SIZE,
+			TIMING_WHEEL_SLOTS = TIMING_WHEEL_READY + 1,
+		};
+
+		template <typename T>
+		struct timing_wheel
+		{
+			T* slots[TIMING_WHEEL_SLOTS];	//! slots[TIMING_WHEEL_READY] holds elements already expired
+			int64_t current;				//! next tick to be processed
+			unsigned n;
+		};
+
+		template <typename T>
+		static inline void	     timing_wheel_ctor(timing_wheel<T>* w, int64_t now);
+
+		template <typename T>
+		static inline void	     timing_wheel_dtor(timing_wheel<T>* w);
+
+		template <typename T>
+		static inline void	     timing_wheel_elem_init(T* e);
+
+		template <typename T>
+		static inline int64_t	 timing_wheel_elem_tick(const T* e);
+
+		template <typename T>
+		static inline int	     timing_wheel_empty(timing_wheel<T>* w);
+
+		template <typename T>
+		static inline unsigned	 timing_wheel_size(timing_wheel<T>* w);
+
+		template <typename T>
+		static inline int	     timing_wheel_push(timing_wheel<T>* w, T* e);
+
+		template <typename T>
+		static inline int	     timing_wheel_erase(timing_wheel<T>* w, T* e);
+
+		template <typename T>
+		static inline T*		 timing_wheel_pop_expired(timing_wheel<T>* w, int64_t now);
+
+		//! next element due before now, nullptr if none. stays queued until timing_wheel_pop
+		template <typename T>
+		static inline T*		 timing_wheel_top(timing_wheel<T>* w, int64_t now);
+
+		//! remove what timing_wheel_top returned
+		template <typename T>
+		static inline T*		 timing_wheel_pop(timing_wheel<T>* w);
+
+		template <typename T>
+		static inline int64_t	 timing_wheel_next_tick(timing_wheel<T>* w);
+
+		template <typename T, typename F>
+		static inline unsigned	 timing_wheel_count_below(timing_wheel<T>* w, int64_t tick, F fn);
+
+		template <typename T>
+		static inline void	     timing_wheel_link_(timing_wheel<T>* w, int slot, T* e);
+
+		template <typename T>
+		static inline void	     timing_wheel_unlink_(timing_wheel<T>* w, T* e);
+
+		template <typename T>
+		static inline void	     timing_wheel_place_(timing_wheel<T>* w, T* e);
+
+		template <typename T>
+		static inline void	     timing_wheel_cascade_(timing_wheel<T>* w, int slot);
+
+		template <typename T>
+		int64_t timing_wheel_elem_tick(const T* e)
+		{
+			return e->tp_;
+		}
+
+		template <typename T>
+		void timing_wheel_ctor(timing_wheel<T>* w, int64_t now)
+		{
+			for (int i = 0; i < TIMING_WHEEL_SLOTS; ++i)
+				w->slots[i] = 0;
+			w->current = now;
+			w->n = 0;
+		}
+
+		template <typename T>
+		void timing_wheel_dtor(timing_wheel<T>* w) { w->n = 0; }
+
+		template <typename T>
+		void timing_wheel_elem_init(T* e) { e->list_slot = -1; e->list_prev = e->list_next = 0; }
+
+		template <typename T>
+		int timing_wheel_empty(timing_wheel<T>* w) { return 0u == w->n; }
+
+		template <typename T>
+		unsigned timing_wheel_size(timing_wheel<T>* w) { return w->n; }
+
+		template <typename T>
+		int timing_wheel_push(timing_wheel<T>* w, T* e)
+		{
+			timing_wheel_place_(w, e);
+			++w->n;
+			return 0;
+		}
+
+		template <typename T>
+		int timing_wheel_erase(timing_wheel<T>* w, T* e)
+		{
+			if (-1 != e->list_slot)
+			{
+				timing_wheel_unlink_(w, e);
+				--w->n;
+				return 0;
+			}
+			return -1;
+		}
+
+		template <typename T>
+		T* timing_wheel_pop_expired(timing_wheel<T>* w, int64_t now)
+		{
+			return timing_wheel_top(w, now) ? timing_wheel_pop(w) : 0;
+		}
+
+		template <typename T>
+		T* timing_wheel_pop(timing_wheel<T>* w)
+		{
+			T* e = w->slots[TIMING_WHEEL_READY];
+			if (e)
+			{
+				timing_wheel_unlink_(w, e);
+				--w->n;
+			}
+			return e;
+		}
+
+		template <typename T>
+		T* timing_wheel_top(timing_wheel<T>* w, int64_t now)
+		{
+			for (;;)
+			{
+				T* e = w->slots[TIMING_WHEEL_READY];
+				if (e)
+					return e;
+
+				if (w->current >= now)
+					return 0;
+
+				if (0u == w->n)
+				{
+					w->current = now;
+					return 0;
+				}
+
+				int idx = static_cast<int>(w->current & (TIMING_WHEEL_ROOT_SIZE - 1));
+				if (0 == idx)
+				{
+					for (int level = 0; level < TIMING_WHEEL_LEVELS; ++level)
+					{
+						int shift = TIMING_WHEEL_ROOT_BITS + level * TIMING_WHEEL_LEVEL_BITS;
+						int lidx = static_cast<int>((w->current >> shift) & (TIMING_WHEEL_LEVEL_SIZE - 1));
+						timing_wheel_cascade_(w, TIMING_WHEEL_ROOT_SIZE + level * TIMING_WHEEL_LEVEL_SIZE + lidx);
+						if (lidx)
+							break;
+					}
+				}
+
+				//! READY is empty here, so the whole slot moves over in one splice
+				T* head = w->slots[idx];
+				if (head)
+				{
+					w->slots[idx] = 0;
+					w->slots[TIMING_WHEEL_READY] = head;
+					T* it = head;
+					do
+					{
+						it->list_slot = TIMING_WHEEL_READY;
+						it = it->list_next;
+					} while (it != head);
+				}
+				++w->current;
+			}
+		}
+
+		//! earliest tick with work: exact when it's in the root slots, else the start of the slot
+		//! that has to cascade first (a lower bound). INT64_MAX when empty
+		template <typename T>
+		int64_t timing_wheel_next_tick(timing_wheel<T>* w)
+		{
+			if (0u == w->n)
+				return INT64_MAX;
+			if (w->slots[TIMING_WHEEL_READY])
+				return w->current - 1;
+
+			//! a root slot holds a single tick in [current, current + 256)
+			int64_t next = INT64_MAX;
+			for (int i = 0; i < TIMING_WHEEL_ROOT_SIZE; ++i)
+			{
+				int64_t tick = w->current + i;
+				if (w->slots[tick & (TIMING_WHEEL_ROOT_SIZE - 1)])
+				{
+					next = tick;
+					break;
+				}
+			}
+
+			//! elements waiting for a cascade may still be earlier. the first occupied slot of each
+			//! level bounds them from below by its start, the tick it cascades at. once current moved
+			//! past a slot's start it was cascaded, whatever is there now belongs to the next revolution
+			for (int level = 0; level < TIMING_WHEEL_LEVELS; ++level)
+			{
+				int shift = TIMING_WHEEL_ROOT_BITS + level * TIMING_WHEEL_LEVEL_BITS;
+				int64_t base = w->current >> shift;
+				int cur = static_cast<int>(base & (TIMING_WHEEL_LEVEL_SIZE - 1));
+				int first = (w->current & ((int64_t(1) << shift) - 1)) ? 1 : 0;
+				for (int i = first; i < first + TIMING_WHEEL_LEVEL_SIZE; ++i)
+				{
+					if (w->slots[TIMING_WHEEL_ROOT_SIZE + level * TIMING_WHEEL_LEVEL_SIZE + ((cur + i) & (TIMING_WHEEL_LEVEL_SIZE - 1))])
+					{
+						int64_t start = i ? (base + i) << shift : w->current;
+						if (start < next)
+							next = start;
+						break;
+					}
+				}
+			}
+			return next;
+		}
+
+		//! sum of fn over the elements due before tick, walks READY, the root slots up to tick and
+		//! the level slots that start before it
+		template <typename T, typename F>
+		unsigned timing_wheel_count_below(timing_wheel<T>* w, int64_t tick, F fn)
+		{
+			unsigned n = 0;
+			auto walk = [&n, &fn, tick](T* head)
+			{
+				T* it = head;
+				if (it)
+				{
+					do
+					{
+						if (timing_wheel_elem_tick(it) < tick)
+							n += fn(it);
+						it = it->list_next;
+					} while (it != head);
+				}
+			};
+
+			walk(w->slots[TIMING_WHEEL_READY]);
+			for (int i = 0; i < TIMING_WHEEL_ROOT_SIZE && w->current + i < tick; ++i)
+				walk(w->slots[(w->current + i) & (TIMING_WHEEL_ROOT_SIZE - 1)]);
+
+			for (int level = 0; level < TIMING_WHEEL_LEVELS; ++level)
+			{
+				int shift = TIMING_WHEEL_ROOT_BITS + level * TIMING_WHEEL_LEVEL_BITS;
+				int64_t base = w->current >> shift;
+				int cur = static_cast<int>(base & (TIMING_WHEEL_LEVEL_SIZE - 1));
+				int first = (w->current & ((int64_t(1) << shift) - 1)) ? 1 : 0;
+				for (int i = first; i < first + TIMING_WHEEL_LEVEL_SIZE; ++i)
+				{
+					int64_t start = i ? (base + i) << shift : w->current;
+					if (start >= tick)
+						break;
+					walk(w->slots[TIMING_WHEEL_ROOT_SIZE + level * TIMING_WHEEL_LEVEL_SIZE + ((cur + i) & (TIMING_WHEEL_LEVEL_SIZE - 1))]);
+				}
+			}
+			return n;
+		}
+
+		template <typename T>
+		void timing_wheel_link_(timing_wheel<T>* w, int slot, T* e)
+		{
+			T* head = w->slots[slot];
+			if (head)
+			{
+				e->list_next = head;
+				e->list_prev = head->list_prev;
+				head->list_prev->list_next = e;
+				head->list_prev = e;
+			}
+			else
+			{
+				e->list_next = e->list_prev = e;
+				w->slots[slot] = e;
+			}
+			e->list_slot = slot;
+		}
+
+		template <typename T>
+		void timing_wheel_unlink_(timing_wheel<T>* w, T* e)
+		{
+			if (e->list_next == e)
+			{
+				w->slots[e->list_slot] = 0;
+			}
+			else
+			{
+				e->list_prev->list_next = e->list_next;
+				e->list_next->list_prev = e->list_prev;
+				if (w->slots[e->list_slot] == e)
+					w->slots[e->list_slot] = e->list_next;
+			}
+			e->list_prev = e->list_next = 0;
+			e->list_slot = -1;
+		}
+
+		template <typename T>
+		void timing_wheel_place_(timing_wheel<T>* w, T* e)
+		{
+			int64_t tick = timing_wheel_elem_tick(e);
+			if (tick < w->current)
+			{
+				timing_wheel_link_(w, TIMING_WHEEL_READY, e);
+				return;
+			}
+
+			uint64_t delta = static_cast<uint64_t>(tick - w->current);
+			if (delta < TIMING_WHEEL_ROOT_SIZE)
+			{
+				timing_wheel_link_(w, static_cast<int>(tick & (TIMING_WHEEL_ROOT_SIZE - 1)), e);
+				return;
+			}
+
+			int level = 0;
+			for (; level < TIMING_WHEEL_LEVELS - 1; ++level)
+			{
+				if (delta < (uint64_t(1) << (TIMING_WHEEL_ROOT_BITS + (level + 1) * TIMING_WHEEL_LEVEL_BITS)))
+					break;
+			}
+
+			if (delta > 0xffffffffu)
+				tick = w->current + 0xffffffffu;
+
+			int shift = TIMING_WHEEL_ROOT_BITS + level * TIMING_WHEEL_LEVEL_BITS;
+			int lidx = static_cast<int>((tick >> shift) & (TIMING_WHEEL_LEVEL_SIZE - 1));
+			timing_wheel_link_(w, TIMING_WHEEL_ROOT_SIZE + level * TIMING_WHEEL_LEVEL_SIZE + lidx, e);
+		}
+
+		template <typename T>
+		void timing_wheel_cascade_(timing_wheel<T>* w, int slot)
+		{
+			T* head = w->slots[slot];
+			if (!head)
+				return;
+
+			w->slots[slot] = 0;
+			head->list_prev->list_next = 0;
+			while (head)
+			{
+				T* next = head->list_next;
+				timing_wheel_place_(w, head);
+				head = next;
+			}
+		}
+	}
+}
+
+#endif